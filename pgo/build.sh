@@ -0,0 +1,54 @@
+#!/bin/sh
+# VT-Rex
+# Copyright (c) 2024 James Holderness
+# Distributed under the MIT License
+#
+# Builds a plain Release binary and a PGO+LTO binary trained on the replays
+# in pgo/corpus, and then reports how they compare when playing back that
+# same corpus headless.
+#
+# Usage: pgo/build.sh [OUTPUT_DIR] [PASSES]
+
+set -e
+
+source_dir=$(cd "$(dirname "$0")/.." && pwd)
+output_dir=${1:-$source_dir/build/pgo}
+passes=${2:-200}
+
+release_dir=$output_dir/release
+optimized_dir=$output_dir/optimized
+
+cmake -S "$source_dir" -B "$release_dir" -D CMAKE_BUILD_TYPE=Release
+cmake --build "$release_dir" --config Release
+
+cmake -S "$source_dir" -B "$optimized_dir" -D CMAKE_BUILD_TYPE=Release -D VTREX_LTO=ON -D VTREX_PGO=GENERATE
+cmake --build "$optimized_dir" --config Release --target pgo-train
+cmake -S "$source_dir" -B "$optimized_dir" -D VTREX_PGO=USE
+cmake --build "$optimized_dir" --config Release
+
+run_corpus() {
+    start=$(date +%s%N)
+    pass=0
+    while [ $pass -lt "$passes" ]; do
+        for replay in "$source_dir"/pgo/corpus/*.replay; do
+            "$1" --headless --replay "$replay"
+        done
+        pass=$((pass + 1))
+    done
+    end=$(date +%s%N)
+    echo $(((end - start) / 1000000))
+}
+
+release_size=$(wc -c < "$release_dir/vtrex")
+optimized_size=$(wc -c < "$optimized_dir/vtrex")
+release_time=$(run_corpus "$release_dir/vtrex")
+optimized_time=$(run_corpus "$optimized_dir/vtrex")
+
+report=$output_dir/report.txt
+{
+    echo "Corpus: $(ls "$source_dir"/pgo/corpus/*.replay | wc -l) replays x $passes passes"
+    echo
+    printf "%-12s %12s %12s\n" "Build" "Size (bytes)" "Time (ms)"
+    printf "%-12s %12s %12s\n" "Release" "$release_size" "$release_time"
+    printf "%-12s %12s %12s\n" "PGO+LTO" "$optimized_size" "$optimized_time"
+} | tee "$report"
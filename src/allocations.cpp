@@ -0,0 +1,120 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "allocations.h"
+
+#ifdef VTREX_TRACK_ALLOCATIONS
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
+
+namespace {
+
+    struct phase_count {
+        const char* name = nullptr;
+        bool allocation_free = false;
+        std::atomic<uint64_t> count = 0;
+    };
+
+    // The phases are held in a fixed array, since the tracking obviously
+    // can't allocate anything itself. They're shared by all the sessions,
+    // but each thread keeps track of the phase it's currently in.
+    std::array<phase_count, 8> phases = {{{"startup"}}};
+    std::mutex phase_mutex;
+    std::atomic<int> phase_count_used = 1;
+    thread_local int current_phase = 0;
+    bool abort_on_failure = false;
+
+    void* allocate(const size_t size)
+    {
+        auto& phase = phases[current_phase];
+        phase.count.fetch_add(1, std::memory_order_relaxed);
+        // Aborting at the point of failure makes it easy to find the source
+        // of the allocation in a debugger.
+        if (phase.allocation_free && abort_on_failure)
+            std::abort();
+        if (const auto p = std::malloc(size ? size : 1))
+            return p;
+        throw std::bad_alloc{};
+    }
+
+}  // namespace
+
+void* operator new(const size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](const size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, const size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, const size_t) noexcept
+{
+    std::free(p);
+}
+
+void allocations::phase(const char* name, const bool allocation_free)
+{
+    // Marking the same phase again is ignored, so it's safe to call this
+    // from within a loop.
+    if (std::strcmp(phases[current_phase].name, name) == 0)
+        return;
+    // If another thread has already entered a phase with this name, we
+    // share its count. Otherwise the next free slot is claimed.
+    const auto lock = std::lock_guard{phase_mutex};
+    auto index = 0;
+    while (index < phase_count_used && std::strcmp(phases[index].name, name) != 0)
+        index++;
+    if (index >= phases.size())
+        return;
+    if (index == phase_count_used) {
+        auto& next = phases[index];
+        next.name = name;
+        next.allocation_free = allocation_free;
+        abort_on_failure = std::getenv("VTREX_ALLOCATION_ABORT") != nullptr;
+        phase_count_used++;
+    }
+    current_phase = index;
+}
+
+bool allocations::report()
+{
+    auto passed = true;
+    std::cerr << "Allocations per phase:\n";
+    for (auto i = 0; i < phase_count_used; i++) {
+        const auto& phase = phases[i];
+        const auto count = phase.count.load();
+        std::cerr << "  " << phase.name << ": " << count << "\n";
+        if (phase.allocation_free && count > 0)
+            passed = false;
+    }
+    if (!passed)
+        std::cerr << "VT-Rex: memory was allocated in an allocation-free phase\n";
+    return passed;
+}
+
+#endif
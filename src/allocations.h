@@ -0,0 +1,29 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+// Allocation tracking is only compiled in when the VTREX_TRACK_ALLOCATIONS
+// option is enabled in the build. It replaces the global operator new with
+// a counting version, and the counts are reported for each phase of the run.
+// A phase can be marked as allocation-free, in which case any allocation in
+// that phase will make the report fail.
+
+#ifdef VTREX_TRACK_ALLOCATIONS
+
+class allocations {
+public:
+    static void phase(const char* name, const bool allocation_free = false);
+    static bool report();
+};
+
+#define ALLOCATION_PHASE(...) allocations::phase(__VA_ARGS__)
+#define ALLOCATION_REPORT() allocations::report()
+
+#else
+
+#define ALLOCATION_PHASE(...)
+#define ALLOCATION_REPORT() true
+
+#endif
@@ -0,0 +1,405 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "bundle.h"
+
+#include "bundle_id.h"
+#include "os.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+// The bundle starts with a header line identifying the build that wrote it,
+// followed by a binary record for each layout. A record is a length, the
+// layout fields, the macro ids and checksum, and then the content, definition
+// and invocation of every macro, in the order they're declared. Numbers are
+// written as native 32-bit integers, which is fine since a bundle is only ever
+// read by the build that wrote it.
+//
+// New layouts are appended to the end of the file, so any instance that has
+// the file mapped is unaffected. If the file needs to be rewritten, because
+// it's damaged or from a different build, or because it's full, the new
+// version is written to a temporary file which then replaces the original.
+// A full bundle drops its oldest records, so it can't grow without limit.
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+namespace {
+
+    std::string_view map_file(const std::string& filename)
+    {
+        const auto file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return {};
+        auto size = LARGE_INTEGER{};
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return {};
+        }
+        const auto mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (!mapping) return {};
+        const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (!view) return {};
+        return {static_cast<const char*>(view), static_cast<size_t>(size.QuadPart)};
+    }
+
+    bool replace_file(const std::string& source, const std::string& target)
+    {
+        return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING);
+    }
+
+}  // namespace
+
+#endif
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    std::string_view map_file(const std::string& filename)
+    {
+        const auto fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return {};
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) < 0 || file_stat.st_size == 0) {
+            close(fd);
+            return {};
+        }
+        const auto length = static_cast<size_t>(file_stat.st_size);
+        const auto view = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED) return {};
+        return {static_cast<const char*>(view), length};
+    }
+
+    bool replace_file(const std::string& source, const std::string& target)
+    {
+        return std::rename(source.c_str(), target.c_str()) == 0;
+    }
+
+}  // namespace
+
+#endif
+
+namespace {
+
+    constexpr auto max_records = 16;
+
+    // The file is mapped the first time it's needed, and stays mapped for
+    // the life of the process, since the loaded macros reference it directly.
+    struct bundle_file {
+        bool opened = false;
+        bool valid = false;
+        std::string filename;
+        std::string header;
+        std::string_view records;
+    } bundle;
+
+    class record_writer {
+    public:
+        void operator()(const int value)
+        {
+            const auto value32 = static_cast<int32_t>(value);
+            _bytes.append(reinterpret_cast<const char*>(&value32), sizeof(value32));
+        }
+
+        void operator()(const scroll_strategy value)
+        {
+            (*this)(static_cast<int>(value));
+        }
+
+        void operator()(const std::string_view text)
+        {
+            (*this)(static_cast<int>(text.length()));
+            _bytes.append(text);
+        }
+
+        void operator()(const macro& macro)
+        {
+            (*this)(macro.content());
+            (*this)(macro.definition());
+            (*this)(macro.invocation());
+        }
+
+        void operator()(const sound_effect& sound)
+        {
+            (*this)(sound.notes);
+            (*this)(sound.duration.count());
+        }
+
+        template <class _Ty, size_t _Size>
+        void operator()(const std::array<_Ty, _Size>& items)
+        {
+            for (const auto& item : items)
+                (*this)(item);
+        }
+
+        const std::string& bytes() const
+        {
+            return _bytes;
+        }
+
+    private:
+        std::string _bytes;
+    };
+
+    class record_reader {
+    public:
+        record_reader(const std::string_view bytes)
+            : _bytes{bytes}
+        {
+        }
+
+        void operator()(int& value)
+        {
+            auto value32 = int32_t{};
+            if (_bytes.length() < sizeof(value32)) {
+                _failed = true;
+                return;
+            }
+            std::memcpy(&value32, _bytes.data(), sizeof(value32));
+            _bytes.remove_prefix(sizeof(value32));
+            value = value32;
+        }
+
+        void operator()(bool& value)
+        {
+            auto value32 = 0;
+            (*this)(value32);
+            value = value32 != 0;
+        }
+
+        void operator()(scroll_strategy& value)
+        {
+            auto value32 = 0;
+            (*this)(value32);
+            value = static_cast<scroll_strategy>(value32);
+        }
+
+        void operator()(std::string_view& text)
+        {
+            auto length = 0;
+            (*this)(length);
+            if (_failed || length < 0 || length > _bytes.length()) {
+                _failed = true;
+                return;
+            }
+            text = _bytes.substr(0, length);
+            _bytes.remove_prefix(length);
+        }
+
+        void operator()(macro& item)
+        {
+            auto content = std::string_view{};
+            auto definition = std::string_view{};
+            auto invocation = std::string_view{};
+            (*this)(content);
+            (*this)(definition);
+            (*this)(invocation);
+            // The checksum is recalculated the same way the macro manager
+            // does it, so we can tell if the content has been damaged.
+            if (!definition.empty())
+                _checksum = macro_manager::update_checksum(_checksum, content);
+            if (!content.empty() || !definition.empty() || !invocation.empty())
+                item = macro::mapped(content, definition, invocation);
+        }
+
+        void operator()(sound_effect& sound)
+        {
+            auto duration = 0;
+            (*this)(sound.notes);
+            (*this)(duration);
+            sound.duration = decltype(sound.duration){duration};
+        }
+
+        template <class _Ty, size_t _Size>
+        void operator()(std::array<_Ty, _Size>& items)
+        {
+            for (auto& item : items)
+                (*this)(item);
+        }
+
+        bool complete() const
+        {
+            return !_failed && _bytes.empty();
+        }
+
+        uint16_t checksum() const
+        {
+            return _checksum;
+        }
+
+    private:
+        std::string_view _bytes;
+        bool _failed = false;
+        uint16_t _checksum = 0;
+    };
+
+    template <typename Stream, typename Layout>
+    void transfer_layout(Stream& stream, Layout& layout)
+    {
+        stream(layout.x_indent);
+        stream(layout.y_indent);
+        stream(layout.playfield_width);
+        stream(layout.has_8bit_controls);
+        stream(layout.has_macros);
+        stream(layout.has_page_flipping);
+        stream(layout.scroller);
+        stream(layout.using_color);
+        stream(layout.sound);
+    }
+
+    template <typename Stream, typename Macros>
+    void transfer_macros(Stream& stream, Macros& macros)
+    {
+        stream(macros.scroll_start);
+        stream(macros.scroll_end);
+        stream(macros.scroll_start_with_clouds);
+        stream(macros.scroll_end_with_clouds);
+        stream(macros.frame_complete);
+        stream(macros.trex_running);
+        stream(macros.trex_jumping);
+        stream(macros.trex_dead);
+        stream(macros.trex_standing);
+        stream(macros.game_over_banner);
+        stream(macros.high_score_label);
+        stream(macros.double_width);
+        stream(macros.cloud_parts);
+        stream(macros.cactus_parts);
+        stream(macros.game_over_sound);
+        stream(macros.jump_sound);
+        stream(macros.score_sound);
+    }
+
+    // Each record is prefixed with its length, so the records that aren't
+    // wanted can be skipped without being parsed. This returns the content of
+    // the next record, or nothing if we've reached the end of the file or the
+    // record is incomplete.
+    std::optional<std::string_view> next_record(std::string_view& records)
+    {
+        auto length = int32_t{};
+        if (records.length() < sizeof(length)) return {};
+        std::memcpy(&length, records.data(), sizeof(length));
+        if (length < 0 || length > records.length() - sizeof(length)) return {};
+        const auto record = records.substr(sizeof(length), length);
+        records.remove_prefix(sizeof(length) + length);
+        return record;
+    }
+
+    // This returns the number of records, or nothing if any are incomplete.
+    std::optional<int> count_records(std::string_view records)
+    {
+        auto count = 0;
+        for (; !records.empty(); count++)
+            if (!next_record(records)) return {};
+        return count;
+    }
+
+    void open_bundle()
+    {
+        if (bundle.opened) return;
+        bundle.opened = true;
+        bundle.filename = os::home_path("VTREX_BUNDLE", ".vtrex-bundle");
+        bundle.header = std::string{"vtrex-bundle 2 "} + bundle_id + "\n";
+        if (bundle.filename.empty()) return;
+        auto records = map_file(bundle.filename);
+        if (!records.starts_with(bundle.header)) return;
+        records.remove_prefix(bundle.header.length());
+        // We check that every record is complete before using any of them,
+        // otherwise anything appended later would be unreachable.
+        if (!count_records(records)) return;
+        bundle.records = records;
+        bundle.valid = true;
+    }
+
+    std::optional<std::string> current_records()
+    {
+        // Another build may have replaced the file since we opened it, and
+        // our records mustn't be appended to a bundle that isn't ours. Other
+        // instances may also have appended records of their own, so this
+        // reads the file as it is now, rather than using the mapped copy.
+        auto file = std::ifstream{bundle.filename, std::ios::binary};
+        auto contents = std::string{std::istreambuf_iterator<char>{file}, {}};
+        if (!contents.starts_with(bundle.header)) return {};
+        return contents.substr(bundle.header.length());
+    }
+
+}  // namespace
+
+std::optional<cached_macros> startup_bundle::load(const macro_layout& layout)
+{
+    open_bundle();
+    for (auto records = bundle.records; !records.empty();) {
+        auto reader = record_reader{next_record(records).value()};
+        auto record_layout = macro_layout{};
+        transfer_layout(reader, record_layout);
+        if (record_layout != layout) continue;
+        auto cached = cached_macros{};
+        auto checksum = 0;
+        reader(cached.layout_ids);
+        reader(checksum);
+        transfer_macros(reader, cached.macros);
+        cached.checksum = static_cast<uint16_t>(checksum);
+        if (reader.complete() && reader.checksum() == cached.checksum)
+            return cached;
+        // If the record is damaged, the file will be rewritten when the
+        // layout is saved again.
+        bundle.valid = false;
+        return {};
+    }
+    return {};
+}
+
+void startup_bundle::save(const macro_layout& layout, const cached_macros& cached)
+{
+    open_bundle();
+    if (bundle.filename.empty()) return;
+    auto writer = record_writer{};
+    transfer_layout(writer, layout);
+    writer(cached.layout_ids);
+    writer(cached.checksum);
+    transfer_macros(writer, cached.macros);
+    auto record = record_writer{};
+    record(static_cast<int>(writer.bytes().length()));
+    const auto& length = record.bytes();
+
+    const auto records = bundle.valid ? current_records() : std::nullopt;
+    const auto record_count = records ? count_records(*records) : std::nullopt;
+    if (record_count && *record_count < max_records) {
+        auto file = std::ofstream{bundle.filename, std::ios::binary | std::ios::app};
+        file << length << writer.bytes();
+        return;
+    }
+    // When the file is full, the most recent records are carried over, and
+    // the oldest are dropped to make room. Otherwise the file is damaged or
+    // from another build, so nothing is carried over, but the records will be
+    // saved again as those layouts are used.
+    auto kept = std::string_view{};
+    if (record_count) {
+        kept = *records;
+        for (auto dropped = 0; dropped <= *record_count - max_records; dropped++)
+            next_record(kept);
+    }
+    const auto temp_filename = bundle.filename + ".tmp";
+    auto file = std::ofstream{temp_filename, std::ios::binary | std::ios::trunc};
+    file << bundle.header << kept << length << writer.bytes();
+    file.close();
+    if (file && replace_file(temp_filename, bundle.filename))
+        bundle.valid = true;
+    else
+        std::remove(temp_filename.c_str());
+}
@@ -0,0 +1,46 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include "macros.h"
+#include "options.h"
+
+#include <cstdint>
+#include <optional>
+
+// Sessions with the same screen layout and terminal features end up with
+// identical macros, so once they've been built for a particular layout, they
+// can be cached, both in memory for later sessions in the same process, and
+// in the startup bundle for later launches. The macros only depend on the
+// screen size through the playfield indents, so that's what the layout holds,
+// and screens that differ by a column or two can share the same macros.
+struct macro_layout {
+    int x_indent;
+    int y_indent;
+    int playfield_width;
+    bool has_8bit_controls;
+    bool has_macros;
+    bool has_page_flipping;
+    scroll_strategy scroller;
+    bool using_color;
+    bool sound;
+    auto operator<=>(const macro_layout&) const = default;
+};
+
+struct cached_macros {
+    macro_set macros;
+    int layout_ids;
+    uint16_t checksum;
+};
+
+// The startup bundle is a file holding the macros for the layouts we've most
+// recently seen, which is mapped into memory so a saved layout can be used
+// without building anything. These aren't thread safe, so the caller is expected to
+// hold the macro cache lock.
+class startup_bundle {
+public:
+    static std::optional<cached_macros> load(const macro_layout& layout);
+    static void save(const macro_layout& layout, const cached_macros& cached);
+};
@@ -4,65 +4,106 @@
 
 #include "capabilities.h"
 
+#include "engine.h"
+#include "options.h"
 #include "os.h"
+#include "profile.h"
+#include "sequences.h"
+#include "trace.h"
 
-#include <cstring>
-#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <vector>
 
-using namespace std::string_literals;
-
-capabilities::capabilities()
+capabilities::capabilities(const options& options, const os& os, std::ostream& out)
+    : _os{os}, _out{out}, _headless{options.headless}
 {
+    TRACE_SCOPE("capabilities");
+    // In headless mode there is no terminal to query, so we just assume the
+    // capabilities of a VT525 with the default screen size, unless a width
+    // has been requested.
+    if (_headless) {
+        width = options.columns.value_or(width);
+        has_soft_fonts = true;
+        has_horizontal_scrolling = true;
+        has_scroll_left = true;
+        has_left_right_margins = true;
+        has_color = true;
+        has_rectangle_ops = true;
+        has_macros = true;
+        has_pages = true;
+        has_8bit_controls = options.eight_bit;
+        return;
+    }
     // Save the cursor position.
-    std::cout << "\0337";
-    // Request 7-bit C1 controls from the terminal.
-    std::cout << "\033 F";
+    _out << "\0337";
+    // Request 8-bit C1 controls from the terminal if the user wants them,
+    // otherwise 7-bit controls.
+    _out << (options.eight_bit ? "\033 G" : "\033 F");
     // Determine the screen size.
-    std::cout << "\033[999;999H\033[6n";
-    const auto size = _query(R"(\x1B\[(\d+);(\d+)R)", false);
-    if (!size.empty()) {
-        height = std::stoi(size[1]);
-        width = std::stoi(size[2]);
+    const auto size_known = _query_screen_size();
+    // Otherwise we fall back to 7-bit controls. If the link isn't 8-bit
+    // clean, the size report may not have made it through, so we need to
+    // ask again once we're back to 7-bit controls.
+    if (options.eight_bit && !has_8bit_controls) {
+        _out << "\033 F";
+        if (!size_known)
+            _query_screen_size();
     }
     // Retrieve the device attributes report.
     _query_device_attributes();
+    // Left and right margins (DECSLRM) are only usable if DECLRMM exists.
+    has_left_right_margins = query_mode(69).has_value();
     // Disable scrollback (DECRPL) so we can use paging.
     _original_decrpl = query_mode(112);
-    std::cout << "\033[?112l";
+    _out << "\033[?112l";
     // Disable page coupling (DECPCCM) so we can test paging.
     _original_decpccm = query_mode(64);
-    std::cout << "\033[?64l";
+    _out << "\033[?64l";
     // Try and move to page 3 and check the result with DECXCPR.
-    std::cout << "\033[3 P\033[?6n";
-    const auto page = _query(R"(\x1B\[\??\d+;\d+(?:;(\d+))?R)", true);
-    if (!page.empty() && page[1].matched)
-        has_pages = std::stoi(page[1]) == 3;
+    has_pages = _query_page(3);
+    // Page flipping requires a fourth page.
+    const auto has_fourth_page = has_pages && _query_page(4);
     // Restore the cursor position.
-    std::cout << "\0338";
+    _out << "\0338";
     // Make sure we've returned to page 1.
-    std::cout << "\033[1 P\033[?64h";
+    _out << "\033[1 P\033[?64h";
+    // If we can flip between pages, we still need to check whether that's
+    // actually any faster than copying the frame onto page 1. A saved profile
+    // for this terminal will already know, unless it's being profiled again.
+    const auto profile = options.profile ? nullptr : terminal_profile::cached(terminal_id);
+    if (profile && profile->page_flipping)
+        has_page_flipping = has_fourth_page && profile->page_flipping.value();
+    else
+        has_page_flipping = has_fourth_page && _page_flipping_faster();
 }
 
 capabilities::~capabilities()
 {
+    // Switch back to 7-bit controls if we'd enabled 8-bit controls.
+    if (has_8bit_controls)
+        _out << "\033 F";
     // Restore the original DECPCCM and DECRPL modes.
     if (_original_decpccm == true)
-        std::cout << "\033[?64h";
+        _out << "\033[?64h";
     else if (_original_decpccm == false)
-        std::cout << "\033[?64l";
+        _out << "\033[?64l";
     if (_original_decrpl == true)
-        std::cout << "\033[?112h";
+        _out << "\033[?112h";
     else if (_original_decrpl == false)
-        std::cout << "\033[?112l";
+        _out << "\033[?112l";
 }
 
 std::optional<bool> capabilities::query_mode(const int mode) const
 {
-    std::cout << "\033[?" << mode << "$p";
-    const auto report = _query(R"(\x1B\[\?(\d+);(\d+)\$y)", true);
-    if (!report.empty()) {
-        const auto returned_mode = std::stoi(report[1]);
-        const auto status = std::stoi(report[2]);
+    if (_headless) return {};
+    _out << "\033[?" << mode << "$p";
+    auto report = csi_report(_query('y', true), 'y');
+    if (report.starts_with('?') && report.ends_with('$')) {
+        report = report.substr(1, report.length() - 2);
+        const auto params = numeric_params(report);
+        const auto returned_mode = params.size() == 2 ? params[0] : 0;
+        const auto status = params.size() == 2 ? params[1] : 0;
         if (returned_mode == mode) {
             if (status == 1) return true;
             if (status == 2) return false;
@@ -73,91 +114,229 @@ std::optional<bool> capabilities::query_mode(const int mode) const
 
 std::string capabilities::query_setting(const std::string_view setting) const
 {
-    std::cout << "\033P$q" << setting << "\033\\";
-    const auto report = _query(R"(\x1BP1\$r(.*)\x1B\\)", true);
-    if (!report.empty())
-        return report[1];
+    if (_headless) return {};
+    _out << "\033P$q" << setting << "\033\\";
+    const auto report = dcs_report(_query('\\', true));
+    if (report.starts_with("1$r"))
+        return std::string{report.substr(3)};
     else
         return {};
 }
 
 std::string capabilities::query_color_table() const
 {
-    std::cout << "\033[2;2$u";
-    const auto report = _query(R"(\x1BP2\$s(.*)\x1B\\)", true);
-    if (!report.empty())
-        return report[1];
+    if (_headless) return {};
+    _out << "\033[2;2$u";
+    const auto report = dcs_report(_query('\\', true));
+    if (report.starts_with("2$s"))
+        return std::string{report.substr(3)};
     else
         return {};
 }
 
+std::optional<int> capabilities::query_macro_checksum() const
+{
+    if (_headless) return {};
+    _out << "\033[?63;1n";
+    const auto report = dcs_report(_query('\\', true));
+    auto checksum = 0;
+    if (report.length() == 7 && report.starts_with("1!~")) {
+        const auto digits = report.substr(3);
+        const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), checksum, 16);
+        if (error == std::errc{} && end == digits.data() + digits.size())
+            return checksum;
+    }
+    return {};
+}
+
+void capabilities::wait_for_output() const
+{
+    // A DSR-CPR round trip tells us when the terminal has finished processing
+    // everything we've sent before it.
+    if (_headless) return;
+    _out << "\033[6n";
+    _query('R', false);
+}
+
+std::ostream& capabilities::output() const
+{
+    return _out;
+}
+
+const os& capabilities::connection() const
+{
+    return _os;
+}
+
+// The reports may use either 7-bit or 8-bit C1 controls. These strip off
+// the introducer and terminator, returning the content in between, or an
+// empty view if the response isn't the kind of report we're expecting.
+
+std::string_view capabilities::csi_report(std::string_view response, const char final_char)
+{
+    if (response.starts_with("\033["))
+        response.remove_prefix(2);
+    else if (response.starts_with('\x9B'))
+        response.remove_prefix(1);
+    else
+        return {};
+    if (!response.ends_with(final_char)) return {};
+    response.remove_suffix(1);
+    const auto valid = std::all_of(response.begin(), response.end(), [](const auto ch) {
+        return ch >= 0x20 && ch <= 0x3F;
+    });
+    return valid ? response : std::string_view{};
+}
+
+std::string_view capabilities::dcs_report(std::string_view response)
+{
+    if (response.starts_with("\033P"))
+        response.remove_prefix(2);
+    else if (response.starts_with('\x90'))
+        response.remove_prefix(1);
+    else
+        return {};
+    if (response.ends_with("\033\\"))
+        response.remove_suffix(2);
+    else if (response.ends_with('\x9C'))
+        response.remove_suffix(1);
+    else
+        return {};
+    return response;
+}
+
+// The parameters must all be numeric. The Reflection Desktop terminal
+// sometimes uses comma separators instead of semicolons in their DA
+// report, so we allow for either. Anything else fails the parse.
+std::vector<int> capabilities::numeric_params(const std::string_view text)
+{
+    if (text.empty()) return {};
+    auto params = std::vector<int>{0};
+    for (const auto ch : text) {
+        if (ch >= '0' && ch <= '9')
+            params.back() = std::min(params.back() * 10 + ch - '0', 99999);
+        else if (ch == ';' || ch == ',')
+            params.push_back(0);
+        else
+            return {};
+    }
+    return params;
+}
+
+bool capabilities::_query_screen_size()
+{
+    _out << "\033[999;999H\033[6n";
+    const auto response = _query('R', false);
+    const auto size = numeric_params(csi_report(response, 'R'));
+    if (size.size() != 2) return false;
+    height = size[0];
+    width = size[1];
+    // If the report came back with an 8-bit CSI, we know the terminal
+    // has accepted 8-bit controls and the link is 8-bit clean.
+    has_8bit_controls = response.starts_with('\x9B');
+    return true;
+}
+
 void capabilities::_query_device_attributes()
 {
-    std::cout << "\033[c";
-    // The Reflection Desktop terminal sometimes uses comma separators
-    // instead of semicolons in their DA report, so we allow for either.
-    const auto report = _query(R"(\x1B\[\?(\d+)([;,\d]*)c)", false);
-    if (!report.empty()) {
+    _out << "\033[c";
+    const auto report = csi_report(_query('c', false), 'c');
+    const auto params = report.starts_with('?') ? numeric_params(report.substr(1)) : std::vector<int>{};
+    if (!params.empty()) {
+        // The full report identifies the terminal model for saved profiles.
+        terminal_id = report.substr(1);
         // The first parameter indicates the terminal conformance level.
-        const auto level = std::stoi(report[1]);
+        const auto level = params[0];
         // Level 4+ conformance implies support for features 28 and 32.
         if (level >= 64) {
             has_rectangle_ops = true;
             has_macros = true;
         }
+        // Level 5 conformance adds the SL and SR scrolling controls.
+        if (level >= 65)
+            has_scroll_left = true;
         // The remaining parameters indicate additional feature extensions.
-        const auto features = report[2].str();
-        const auto digits = std::regex(R"(\d+)");
-        auto it = std::sregex_iterator(features.begin(), features.end(), digits);
-        while (it != std::sregex_iterator()) {
-            const auto feature = std::stoi(it->str());
-            switch (feature) {
+        for (auto i = size_t{1}; i < params.size(); i++) {
+            switch (params[i]) {
                 case 7: has_soft_fonts = true; break;
                 case 21: has_horizontal_scrolling = true; break;
                 case 22: has_color = true; break;
                 case 28: has_rectangle_ops = true; break;
                 case 32: has_macros = true; break;
             }
-            it++;
         }
     }
 }
 
-std::smatch capabilities::_query(const char* pattern, const bool may_not_work)
+bool capabilities::_query_page(const int page) const
+{
+    _out << "\033[" << page << " P\033[?6n";
+    auto report = csi_report(_query('R', true), 'R');
+    if (report.starts_with('?')) report.remove_prefix(1);
+    const auto params = numeric_params(report);
+    return params.size() == 3 && params[2] == page;
+}
+
+bool capabilities::_page_flipping_faster() const
+{
+    // We time a batch of page flips against a batch of the copies that the
+    // frame_complete macro would otherwise make, waiting until the terminal
+    // has finished processing them. That's the 7 rows of the playfield that
+    // change each frame, for the playfield width this screen will use, at
+    // the same position. The flips are all to page 1, and the copies are
+    // from page 3 to page 4, so there's nothing visible on the screen.
+    const auto time_batch = [&](const auto&... sequences) {
+        static constexpr auto batch_size = 16;
+        const auto start = std::chrono::steady_clock::now();
+        for (auto i = 0; i < batch_size; i++)
+            (_out << ... << sequences);
+        wait_for_output();
+        return std::chrono::steady_clock::now() - start;
+    };
+    const auto playfield_width = engine_base::width_for(width);
+    const auto top = std::max((height - engine_base::height) / 2, 1) + 2;
+    const auto left = std::max((width - playfield_width * 2) / 4, 0) + 1;
+    const auto right = left + playfield_width - 1;
+    const auto flip_time = time_batch(vt::decset(64), vt::ppa(1), vt::decrst(64));
+    const auto copy_time = time_batch(vt::deccra(top, left, top + 6, right, 3, top, left, 4));
+    _out << vt::decset(64);
+    return flip_time < copy_time;
+}
+
+std::string_view capabilities::_query(char final_char, const bool may_not_work) const
 {
-    auto final_char = pattern[strlen(pattern) - 1];
     if (may_not_work) {
         // If we're uncertain this query is supported, we'll send an extra DA
         // or DSR-CPR query to make sure that we get some kind of response.
         if (final_char == 'R') {
             final_char = 'c';
-            std::cout << "\033[c";
+            _out << "\033[c";
         } else {
             final_char = 'R';
-            std::cout << "\033[6n";
+            _out << "\033[6n";
         }
     }
-    std::cout.flush();
-    // This needs to be static so the returned smatch can reference it.
-    static auto response = std::string{};
-    response.clear();
+    _out.flush();
+    // The response is held in a member so the returned view can reference it.
+    _response.clear();
     auto last_escape = 0;
     for (;;) {
-        const auto ch = os::getch();
+        const auto ch = _os.getch();
+        // If the connection has been closed, there's no response to parse.
+        if (ch < 0)
+            return {};
         // Ignore XON, XOFF
         if (ch == '\021' || ch == '\023')
             continue;
         // If we've sent an extra query, the last escape should be the
         // start of that response, which we'll ultimately drop.
-        if (may_not_work && ch == '\033')
-            last_escape = response.length();
-        response += ch;
+        if (may_not_work && (ch == '\033' || ch == 0x9B))
+            last_escape = _response.length();
+        _response += ch;
         if (ch == final_char) break;
     }
     // Drop the extra response if one was requested.
     if (may_not_work)
-        response = response.substr(0, last_escape);
-    auto match = std::smatch{};
-    std::regex_match(response, match, std::regex(pattern));
-    return match;
+        _response.resize(last_escape);
+    return _response;
 }
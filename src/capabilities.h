@@ -4,32 +4,56 @@
 
 #pragma once
 
+#include <chrono>
 #include <optional>
-#include <regex>
+#include <ostream>
 #include <string>
 #include <string_view>
+#include <vector>
+
+class options;
+class os;
 
 class capabilities {
 public:
-    capabilities();
+    capabilities(const options& options, const os& os, std::ostream& out);
     ~capabilities();
     std::optional<bool> query_mode(const int mode) const;
     std::string query_setting(const std::string_view setting) const;
     std::string query_color_table() const;
+    std::optional<int> query_macro_checksum() const;
+    void wait_for_output() const;
+    std::ostream& output() const;
+    const os& connection() const;
+    static std::string_view csi_report(std::string_view response, const char final_char);
+    static std::string_view dcs_report(std::string_view response);
+    static std::vector<int> numeric_params(const std::string_view text);
 
     int width = 80;
     int height = 24;
     bool has_soft_fonts = false;
     bool has_horizontal_scrolling = false;
+    bool has_scroll_left = false;
+    bool has_left_right_margins = false;
     bool has_color = false;
     bool has_rectangle_ops = false;
     bool has_macros = false;
     bool has_pages = false;
+    bool has_page_flipping = false;
+    bool has_8bit_controls = false;
+    std::string terminal_id;
 
 private:
+    bool _query_screen_size();
     void _query_device_attributes();
-    static std::smatch _query(const char* pattern, const bool may_not_work);
+    bool _query_page(const int page) const;
+    bool _page_flipping_faster() const;
+    std::string_view _query(char final_char, const bool may_not_work) const;
 
+    const os& _os;
+    std::ostream& _out;
+    bool _headless = false;
     std::optional<bool> _original_decrpl;
     std::optional<bool> _original_decpccm;
+    mutable std::string _response;
 };
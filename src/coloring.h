@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <ostream>
 #include <string>
 
 class capabilities;
@@ -15,6 +16,7 @@ public:
     ~coloring();
 
 private:
+    std::ostream& _out;
     bool _using_colors;
     std::string _color_assignment;
     std::string _color_table;
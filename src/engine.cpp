@@ -4,15 +4,17 @@
 
 #include "engine.h"
 
+#include "allocations.h"
+#include "keyboard.h"
 #include "macros.h"
 #include "options.h"
-#include "os.h"
+#include "replay.h"
+#include "scores.h"
+#include "sequences.h"
+#include "trace.h"
 
-#include <iomanip>
-#include <iostream>
-#include <random>
+#include <string_view>
 #include <thread>
-#include <vector>
 
 using namespace std::string_literals;
 using namespace std::chrono_literals;
@@ -20,188 +22,348 @@ using namespace std::chrono_literals;
 using std::chrono::duration_cast;
 using std::chrono::milliseconds;
 using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+    // The landscape is laid out in slots of a fixed length, each of which
+    // holds a single cactus or cloud, starting at a random offset within the
+    // slot. Cactus slots are 24 columns, with a start offset up to 8, so they
+    // are at least 16 columns apart, which leaves room to land between them,
+    // and at most 32 apart, so there's never long to wait for the next one.
+    // Cloud slots are measured in cloud steps (every second column), and the
+    // ground comes in segments the length of its patterns.
+    constexpr auto cactus_slot = 24;
+    constexpr auto cactus_offsets = 9;
+    constexpr auto cloud_slot = 10;
+    constexpr auto cloud_offsets = 8;
+    constexpr auto cloud_parts = 3;
+
+    // Each cactus type is made up of a number of parts, one per column.
+    constexpr auto cactus_types = std::array<std::array<int, 4>, 6>{{
+        {1},
+        {1, 2},
+        {1, 3, 4},
+        {5, 6},
+        {5, 7, 8},
+        {5, 9, 10, 11},
+    }};
+
+    constexpr auto flat_ground = std::string_view{"=-~_~-_-=-_-_~_-_~_=~-_-~-=-_-"};
+    constexpr auto bumpy_ground = std::string_view{"=-~_~-#$%-_-_~_-_~_=~-*+~-=-_-"};
+    constexpr auto ground_segment = static_cast<int>(flat_ground.length());
+    static_assert(bumpy_ground.length() == ground_segment);
 
-static auto rand_seed = std::random_device{};
-static auto rand_engine = std::mt19937{rand_seed()};
+    // Every random decision is drawn from a separate stream.
+    enum stream {
+        ground_stream,
+        cactus_stream,
+        cloud_stream,
+    };
+
+    // SplitMix64, used as a hash function rather than a sequence.
+    uint64_t mix(uint64_t value)
+    {
+        value += 0x9E3779B97F4A7C15;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+        return value ^ (value >> 31);
+    }
+
+    // Rounds towards negative infinity, so the slots carry on below zero.
+    int floor_div(const int value, const int divisor)
+    {
+        return value / divisor - (value % divisor < 0 ? 1 : 0);
+    }
+
+    void write_score(std::ostream& out, const int score)
+    {
+        // Scores are shown as five digits with leading zeros. We format them
+        // by hand rather than going through the stream's number formatting,
+        // which isn't guaranteed to be free of allocations.
+        auto digits = std::array<char, 5>{};
+        auto value = score % 100000;
+        for (auto i = digits.size(); i-- > 0; value /= 10)
+            digits[i] = static_cast<char>('0' + value % 10);
+        out.write(digits.data(), digits.size());
+    }
 
-engine::engine(const macro_manager& macros, const options& options)
-    : _macros{macros}, _options{options}
+}  // namespace
+
+int engine_base::width_for(const int screen_width)
 {
+    return screen_width >= wide_width * 2 ? wide_width : narrow_width;
 }
 
-bool engine::run()
+engine_base::generator::generator(const unsigned seed, const int game)
+    : _key{mix((uint64_t{seed} << 32) | static_cast<uint32_t>(game))}
 {
-    volatile auto exit_requested = false;
-    volatile auto keyboard_shutdown = false;
-    auto keyboard_thread = std::thread([&]() {
-        while (!keyboard_shutdown && !exit_requested) {
-            const auto ch = os::getch();
-            if (ch == 32) {
-                _jump_pressed = true;
-            } else if (ch == 'q' || ch == 'Q' || ch == 27 || ch == 3) {
-                exit_requested = true;
-            }
-        }
-    });
+}
 
-    _render_high_score();
+char engine_base::generator::ground(const int distance) const
+{
+    // A quarter of the ground segments are bumpy.
+    const auto segment = floor_div(distance, ground_segment);
+    const auto& ground = _random(ground_stream, segment) % 4 ? flat_ground : bumpy_ground;
+    return ground[distance - segment * ground_segment];
+}
+
+int engine_base::generator::cactus(const int distance) const
+{
+    if (distance < 0) return 0;
+    const auto slot = distance / cactus_slot;
+    const auto random = _random(cactus_stream, slot);
+    const auto offset = distance - slot * cactus_slot - static_cast<int>(random % cactus_offsets);
+    if (offset < 0 || offset >= cactus_types[0].size()) return 0;
+    // We avoid repeating the type chosen for the previous slot. That slot
+    // may itself have been changed, so this doesn't rule out every repeat,
+    // but it only takes one extra lookup.
+    auto type = (random >> 8) % 6;
+    if (slot > 0 && type == (_random(cactus_stream, slot - 1) >> 8) % 6)
+        type = (type + 1) % 6;
+    return cactus_types[type][offset];
+}
+
+int engine_base::generator::cloud(const int distance) const
+{
+    if (distance < 0) return -1;
+    const auto step = distance / 2;
+    const auto slot = step / cloud_slot;
+    const auto random = _random(cloud_stream, slot);
+    const auto offset = step - slot * cloud_slot - static_cast<int>(random % cloud_offsets);
+    if (offset < 0 || offset >= cloud_parts) return -1;
+    // The height avoids repeating the previous slot, like the cactus type.
+    auto height = (random >> 8) % 3;
+    if (slot > 0 && height == (_random(cloud_stream, slot - 1) >> 8) % 3)
+        height = (height + 1) % 3;
+    return static_cast<int>(height) * cloud_parts + offset;
+}
+
+uint64_t engine_base::generator::_random(const int stream, const int index) const
+{
+    return mix(_key ^ mix((uint64_t{static_cast<uint32_t>(stream)} << 32) | static_cast<uint32_t>(index)));
+}
+
+template <int _Width>
+engine<_Width>::engine(macro_manager& macros, const options& options, replay& replay, score_table& scores, keyboard& keyboard, const generator& generator)
+    : _out{macros.output()}, _macros{macros}, _options{options}, _replay{replay}, _scores{scores}, _keyboard{keyboard}, _generator{generator}
+{
+}
+
+template <int _Width>
+bool engine<_Width>::run()
+{
+    // In headless mode we don't wait for the frame timing, so a recorded
+    // game is just played back as fast as possible.
+    const auto headless = _options.headless;
+    if (!headless)
+        _relayout();
 
     // We need to clear out pages 2 and 3 at the start of each run. On some
     // terminals (like PowerTerm and RLogin) this must be done with ED2 for
     // it to work on a background page. We also designate the soft font on
     // these two pages - it shouldn't be necessary, but RLogin requires it.
-    std::cout << "\033[3 P\033[2J\033( @";
-    std::cout << "\033[2 P\033[2J\033( @";
+    if (_macros.compose_pages() == 1) {
+        _render_high_score();
+        _out << "\033[3 P\033[2J\033( @";
+    } else {
+        // When page flipping, pages 3 and 4 are displayed directly, so they
+        // also need the double width lines and the high score. We prepare
+        // page 3 last, since that's where the first frame will be composed.
+        for (auto page = 4; page >= 3; page--) {
+            _out << vt::ppa(page) << "\033[2J\033( @";
+            _macros.double_width.run(_out);
+            _render_high_score();
+        }
+    }
+    _out << "\033[2 P\033[2J\033( @";
 
     // RLogin also requires that the origin mode is set on the the specific
     // page where it's needed, which for us is page 2.
-    std::cout << "\033[?6h";
+    _out << "\033[?6h";
 
     // We start by rendering the ground for the full width of the game area.
-    std::cout << "\033[10H";
-    for (auto i = 0; i < width; i++)
-        _render_ground();
+    // On the wide layout, that includes the start of the landscape, so there
+    // may already be cactuses on screen. A cactus part moves the cursor, so
+    // the next column needs a new position.
+    _out << "\033[10H";
+    auto cursor_valid = true;
+    for (auto i = -width; i < 0; i++) {
+        const auto distance = i + landscape_offset;
+        if (!cursor_valid)
+            _out << vt::cup(10, width + i + 1);
+        cursor_valid = _render_column({_generator.ground(distance), _generator.cactus(distance)});
+    }
 
-    const auto start_time = std::chrono::steady_clock::now();
+    const auto start_time = steady_clock::now();
     const auto start_frame_len = 1000ms / _options.fps;
     auto frame_end = start_time + 1000ms;
-    for (_distance = 0; !exit_requested; _distance++) {
-        // We speed up over time by shortening the frame length by 250us every 1s.
-        const auto elapsed = duration_cast<seconds>(frame_end - start_time);
-        _frame_len = duration_cast<milliseconds>(start_frame_len - 250us * elapsed.count());
-        _frame_len = std::max(_frame_len, 33ms);
-
-        // Every frame we scroll the landscape left by one column, and add a
-        // new piece of ground, but the clouds move at a slower rate, so we
-        // only scroll them on every second frame. However, there are two
-        // versions of the cloud layer, one of which is offset by a half a
-        // column, and we swap between these two renditions on every frame.
-        // So this way they are actually moving every frame, but with a half
-        // column step each time.
-        if ((_distance & 1) == 0) {
-            _macros.scroll_start.run();
-            _render_landscape();
-            _macros.scroll_end.run();
-        } else {
-            _macros.scroll_start_with_clouds.run();
-            _render_landscape();
-            _render_clouds();
-            _macros.scroll_end_with_clouds.run();
+    auto next_distance = 0;
+    while (!_keyboard.exit_requested()) {
+        // The simulation runs on a fixed timestep, independent of the rate
+        // at which the terminal can accept our output. Normally there's one
+        // tick per frame, but if the output has stalled, we advance through
+        // all the ticks that have come due, and render them in a single frame,
+        // so the game speed stays the same however slow the terminal is.
+        //
+        // The trex step of the final tick is held back until the landscape
+        // has been rendered, so the jump key is latched as late as possible,
+        // just before the trex and the collision are decided and the frame
+        // is written out.
+        _column_count = 0;
+        auto trex_pending = false;
+        for (;;) {
+            _distance = next_distance++;
+
+            // We speed up over time by shortening the frame length by 250us every 1s.
+            const auto elapsed = duration_cast<seconds>(frame_end - start_time);
+            _frame_len = duration_cast<milliseconds>(start_frame_len - 250us * elapsed.count());
+            _frame_len = std::max(_frame_len, 33ms);
+
+            _advance();
+            if (headless || _column_count >= max_catch_up || steady_clock::now() < frame_end) {
+                trex_pending = true;
+                break;
+            }
+            _advance_player();
+            if (_game_over) break;
+            frame_end += _frame_len;
         }
 
-        // The landscape scrolling takes place on page 2, but once it's done
-        // the content is copied onto page 3, so we can render the dinosaur
-        // on top of that.
+        // If the screen size has changed, the layout is adjusted to match
+        // before we render anything else.
+        if (!headless)
+            _relayout();
+
+        // The landscape is rendered on page 2, but once it's done the content
+        // is copied onto page 3, so we can render the dinosaur on top of that.
+        _render_landscape();
+        if (trex_pending)
+            _advance_player();
         _render_trex();
 
         // Once that's done, we'll copy the final composited frame back to
         // page 1 (the visible page), and add update the current score.
-        _macros.frame_complete.run();
+        {
+            TRACE_SCOPE("frame_complete");
+            _macros.frame_complete[_compose_page].run(_out);
+        }
         _render_score();
 
         // Any sound effects must be output as the last step in this sequence,
         // because they'll block further output until they're complete.
-        _play_sound_effects();
-        std::cout.flush();
+        _play_sound_effects(frame_end);
+        _frames_rendered++;
+        _compose_page = (_compose_page + 1) % _macros.compose_pages();
+        {
+            TRACE_SCOPE("flush");
+            _out.flush();
+        }
+        _record_jump_latency();
         if (_game_over) break;
 
-        std::this_thread::sleep_until(frame_end);
+        // Any macros that weren't needed for the first frame are uploaded
+        // in whatever time we have left before the next frame is due.
+        _macros.upload_pending(frame_end);
+        ALLOCATION_PHASE("frame loop", true);
+
+        if (!headless) {
+            TRACE_SCOPE("sleep");
+            // If a sound effect is still going to be playing when the next
+            // frame is due, there's no point sending it until the terminal
+            // is free. The ticks we miss in the meantime are caught up in the
+            // following frame.
+            std::this_thread::sleep_until(std::max(frame_end, _sound_end));
+
+            // If we've fallen so far behind that we can't catch up, the game
+            // clock will just have to slip.
+            const auto now = steady_clock::now();
+            if (now - frame_end > 1s)
+                frame_end = now;
+        }
         frame_end += _frame_len;
     }
 
-    if (!exit_requested) {
-        _macros.game_over_banner.run();
-        _render_high_score();
-        _macros.game_over_sound.run();
-        std::cout.flush();
+    if (_keyboard.exit_requested())
+        return false;
+
+    _macros.game_over_banner.run(_out);
+    _render_high_score();
+    _macros.game_over_sound.notes.run(_out);
+    _out.flush();
+    if (!headless)
         std::this_thread::sleep_for(500ms);
-    }
 
-    keyboard_shutdown = true;
-    keyboard_thread.join();
-    return !exit_requested;
+    // The next game starts when a key is pressed, unless it's the exit key.
+    return _keyboard.wait_for_key();
 }
 
-void engine::_render_landscape()
+template <int _Width>
+int engine<_Width>::frames_rendered() const
 {
-    static const auto cactus_types = std::array<std::vector<size_t>, 6>{{
-        {1},
-        {1, 2},
-        {1, 3, 4},
-        {5, 6},
-        {5, 7, 8},
-        {5, 9, 10, 11},
-    }};
-    static auto rand_cactus_type = std::uniform_int_distribution<>{0, 60};
-    static auto last_type = -1;
-
-    const auto render_cactus = [&]() {
-        if (_cactus_buffer.empty()) {
-            if (_distance - _last_cactus_pos < 15) return false;
-            auto type = rand_cactus_type(rand_engine);
-            if (_distance - _last_cactus_pos >= width + 4) type %= 6;
-            if (type == last_type) type = (type + 1) % 6;
-            if (type >= 6) return false;
-            _last_cactus_pos = _distance;
-            last_type = type;
-            for (auto cactus_part : cactus_types[type])
-                _cactus_buffer.push_back(cactus_part);
-        }
-        _macros.cactus_parts[_cactus_buffer.pop_front()].run();
-        return true;
-    };
+    return _frames_rendered;
+}
 
-    if (!render_cactus()) {
-        _cactus_buffer.push_back(0);
-        _cactus_buffer.pop_front();
-        _render_ground();
+template <int _Width>
+void engine<_Width>::_advance()
+{
+    // Every tick we scroll the landscape left by one column, and add a new
+    // piece of ground, but the clouds move at a slower rate, so we only
+    // scroll them on every second tick. However, there are two versions of
+    // the cloud layer, one of which is offset by a half a column, and we swap
+    // between these two renditions on every tick. So this way they are
+    // actually moving every tick, but with a half column step each time.
+    auto& column = _columns[_column_count++];
+    column = {};
+    _advance_landscape(column);
+    if (_distance & 1) {
+        column.cloud_step = true;
+        column.cloud = _generator.cloud(_distance);
     }
-
-    const auto cactus_present = [&](const auto distance_from_left) {
-        const auto distance_from_right = width - distance_from_left;
-        return _cactus_buffer[-distance_from_right] > 0;
-    };
-    _jump_required = cactus_present(3) || cactus_present(4);
 }
 
-void engine::_render_ground()
+template <int _Width>
+void engine<_Width>::_advance_player()
 {
-    static const auto flat_ground = "=-~_~-_-=-_-_~_-_~_=~-_-~-=-_-"s;
-    static const auto bumpy_ground = "=-~_~-#$%-_-_~_-_~_=~-*+~-=-_-"s;
-    static auto rand_ground = std::uniform_int_distribution<>{0, 3};
-    if (_ground_buffer.empty()) {
-        const auto& ground = rand_ground(rand_engine) ? flat_ground : bumpy_ground;
-        for (auto ch : ground)
-            _ground_buffer.push_back(ch);
-    }
-    std::cout << _ground_buffer.pop_front();
+    // While a replay is playing, the jumps come from the recording, and the
+    // space bar is ignored.
+    const auto key_pressed = _keyboard.jump_pressed();
+    if (key_pressed && !_jump_pressed && !_replay.playing())
+        _jump_key_time = _keyboard.jump_time();
+    if (_replay.playing() ? _replay.jump_at(_distance) : key_pressed)
+        _jump_pressed = true;
+    _advance_trex();
+    _queue_sound_effects();
 }
 
-void engine::_render_clouds()
+template <int _Width>
+void engine<_Width>::_advance_landscape(column& column)
 {
-    static auto rand_cloud_height = std::uniform_int_distribution<>{0, 30};
-    static auto last_height = -1;
-    if (_cloud_buffer.empty()) {
-        auto height = rand_cloud_height(rand_engine);
-        if (_distance - _last_cloud_pos >= width) height %= 3;
-        if (height == last_height) height = (height + 1) % 3;
-        if (height > 2) return;
-        _last_cloud_pos = _distance;
-        last_height = height;
-        for (auto i = 0; i < 3; i++)
-            _cloud_buffer.push_back(height * 3 + i);
-    }
-    _macros.cloud_parts[_cloud_buffer.pop_front()].run();
+    const auto distance = _distance + landscape_offset;
+    column.cactus = _generator.cactus(distance);
+    if (!column.cactus)
+        column.ground = _generator.ground(distance);
+
+    // A jump is required if there's a cactus under the trex, which is the
+    // fourth and fifth columns from the left.
+    const auto cactus_present = [&](const auto distance_from_left) {
+        const auto distance_from_right = width - distance_from_left;
+        return _generator.cactus(distance + 1 - distance_from_right) > 0;
+    };
+    _jump_required = cactus_present(3) || cactus_present(4);
 }
 
-void engine::_render_trex()
+template <int _Width>
+void engine<_Width>::_advance_trex()
 {
     static constexpr auto jump_heights = std::array{0, 2, 4, 6, 7, 8, 8, 7, 6, 4, 2, 0};
-    auto height = 0;
     auto next_height = 0;
+    _trex_height = 0;
     if (_jump_pressed) {
         _jump_time++;
-        height = jump_heights[_jump_time];
+        if (_jump_time == 1)
+            _replay.record_jump(_distance);
+        _trex_height = jump_heights[_jump_time];
         if (_jump_time + 1 >= jump_heights.size()) {
             _jump_time = 0;
             _jump_pressed = false;
@@ -211,76 +373,188 @@ void engine::_render_trex()
     }
 
     _game_over = _jump_required && next_height < 4;
+}
+
+template <int _Width>
+void engine<_Width>::_queue_sound_effects()
+{
+    // During a catch-up burst, effects can be queued faster than DECPS plays
+    // them. Once the queue is full, any further effects are just dropped.
+    if (_options.sound && !_game_over) {
+        const auto score = _distance >> 1;
+        const auto score_unit = score % 100;
+        if (score_unit < 2 && score >= 100 && (_distance & 1) == 0)
+            _sound_effects.push_back(&_macros.score_sound[score_unit]);
+        else if (_jump_time == 1)
+            _sound_effects.push_back(&_macros.jump_sound);
+    }
+}
 
-    if (height > 0)
-        _macros.trex_jumping[height].run();
+template <int _Width>
+void engine<_Width>::_render_landscape()
+{
+    TRACE_SCOPE("_render_landscape");
+    const auto& last_column = _columns[_column_count - 1];
+    if (_column_count == 1) {
+        // In the usual case of a single tick, the scrolling is handled by the
+        // scroller macros, and we just need to fill in the new column.
+        if (!last_column.cloud_step) {
+            _macros.scroll_start.run(_out);
+            _render_column(last_column);
+            _macros.scroll_end[_compose_page].run(_out);
+        } else {
+            _macros.scroll_start_with_clouds.run(_out);
+            _render_column(last_column);
+            if (last_column.cloud >= 0)
+                _macros.cloud_parts[last_column.cloud].run(_out);
+            _macros.scroll_end_with_clouds[_compose_page].run(_out);
+        }
+        return;
+    }
+
+    // When catching up on multiple ticks, the ground can be scrolled by all
+    // of them at once, but the clouds are still scrolled a step at a time,
+    // since the cloud parts are always rendered in the rightmost column.
+    _out << vt::ppa(2) << vt::decstbm(8, 10) << vt::decdc(_column_count);
+    for (auto i = 0; i < _column_count; i++) {
+        const auto& column = _columns[i];
+        if (column.cloud_step) {
+            _out << vt::decstbm(1, 7) << vt::decdc();
+            if (column.cloud >= 0)
+                _macros.cloud_parts[column.cloud].run(_out);
+        }
+    }
+    _out << vt::decstbm();
+
+    // The new ground columns are then filled in from left to right. A cactus
+    // part moves the cursor, so the next column needs a new position.
+    auto cursor_valid = false;
+    for (auto i = 0; i < _column_count; i++) {
+        if (!cursor_valid)
+            _out << vt::cup(10, width - _column_count + 1 + i);
+        cursor_valid = _render_column(_columns[i]);
+    }
+
+    if (!last_column.cloud_step)
+        _macros.scroll_end[_compose_page].run(_out);
+    else
+        _macros.scroll_end_with_clouds[_compose_page].run(_out);
+}
+
+template <int _Width>
+bool engine<_Width>::_render_column(const column& column)
+{
+    if (column.cactus > 0) {
+        _macros.cactus_parts[column.cactus].run(_out);
+        return false;
+    }
+    _out << column.ground;
+    return true;
+}
+
+template <int _Width>
+void engine<_Width>::_render_trex()
+{
+    TRACE_SCOPE("_render_trex");
+    if (_trex_height > 0)
+        _macros.trex_jumping[_trex_height].run(_out);
     else if (_distance == 0 || _game_over)
-        _macros.trex_standing.run();
+        _macros.trex_standing.run(_out);
     else
-        _macros.trex_running[(_distance >> 1) & 1].run();
+        _macros.trex_running[(_distance >> 1) & 1].run(_out);
 
     if (_game_over)
-        _macros.trex_dead[height >> 1].run();
+        _macros.trex_dead[_trex_height >> 1].run(_out);
 }
 
-void engine::_render_score()
+template <int _Width>
+void engine<_Width>::_render_score()
 {
+    TRACE_SCOPE("_render_score");
     const auto score = _distance >> 1;
     const auto frame_units = _distance % 200;
     const auto blink_segment = std::max<int>(500ms / _frame_len, 1);
     const auto blink_duration = 1700ms / _frame_len;
     const auto blink_visible = (frame_units % blink_segment) >= (blink_segment >> 1);
     if (_game_over || score < 100 || frame_units > blink_duration)
-        std::cout << std::setfill('0') << std::setw(5) << (score % 100000);
+        write_score(_out, score);
     else if (blink_visible || !_options.blink)
-        std::cout << std::setfill('0') << std::setw(5) << (score % 100000 - score % 100);
+        write_score(_out, score - score % 100);
     else
-        std::cout << "     ";
+        _out << "     ";
 }
 
-void engine::_render_high_score()
+template <int _Width>
+void engine<_Width>::_render_high_score()
 {
-    static auto high_score = 0;
-    const auto score = _distance >> 1;
-    high_score = std::max(high_score, score);
-    if (high_score > 0) {
-        _macros.high_score_label.run();
-        std::cout << std::setfill('0') << std::setw(5) << (high_score % 100000);
-    }
+    // The high score is shared with any other instances that are running,
+    // so it may have been beaten by someone else since we last looked.
+    _scores.submit(_distance >> 1);
+    _display_high_score();
 }
 
-void engine::_play_sound_effects()
+template <int _Width>
+void engine<_Width>::_display_high_score()
 {
-    if (_options.sound && !_game_over) {
-        const auto score = _distance >> 1;
-        const auto score_unit = score % 100;
-        if (score_unit < 2 && score >= 100 && (_distance & 1) == 0)
-            _macros.score_sound[score_unit].run();
-        else if (_jump_time == 1)
-            _macros.jump_sound.run();
+    const auto high_score = _scores.best();
+    if (high_score > 0) {
+        _macros.high_score_label.run(_out);
+        write_score(_out, high_score);
     }
 }
 
-template <class _Ty, int _Size>
-bool engine::buffer<_Ty, _Size>::empty() const
+template <int _Width>
+void engine<_Width>::_relayout()
 {
-    return _front >= _back;
+    if (!_macros.relayout()) return;
+    // The landscape on page 2 doesn't depend on the layout, so that can be
+    // left as it is, but everything on the visible and compose pages needs
+    // to be redrawn in the new position. Clearing a page also resets its
+    // line attributes, so the double width lines have to be reapplied.
+    const auto flipping = _macros.compose_pages() > 1;
+    for (const auto page : flipping ? std::array{4, 3} : std::array{3, 1}) {
+        _out << vt::ppa(page) << "\033[2J\033( @";
+        if (flipping || page == 1) {
+            _macros.double_width.run(_out);
+            _display_high_score();
+        }
+    }
+    // The compose pages are then refilled with a copy of the landscape,
+    // which the next frame will build on.
+    for (auto page = 0; page < _macros.compose_pages(); page++)
+        _macros.scroll_end_with_clouds[page].run(_out);
 }
 
-template <class _Ty, int _Size>
-void engine::buffer<_Ty, _Size>::push_back(const _Ty value)
+template <int _Width>
+void engine<_Width>::_play_sound_effects(const steady_clock::time_point frame_end)
 {
-    _values[_back++ % _Size] = value;
+    TRACE_SCOPE("_play_sound_effects");
+    // We keep track of when the terminal will have finished playing the
+    // sounds we've sent, assuming it starts on them around the time the
+    // frame was scheduled. If it's going to be busy past the next frame
+    // deadline, the remaining effects are held back for a later frame,
+    // rather than stacking up and stalling the output even further.
+    // This is calculated from the frame schedule rather than the clock,
+    // so the output is still deterministic in headless mode.
+    const auto frame_start = frame_end - _frame_len;
+    while (!_sound_effects.empty() && _sound_end < frame_end) {
+        const auto sound_effect = _sound_effects.pop_front();
+        if (_game_over) continue;
+        sound_effect->notes.run(_out);
+        _sound_end = std::max(_sound_end, frame_start) + sound_effect->duration;
+    }
 }
 
-template <class _Ty, int _Size>
-_Ty engine::buffer<_Ty, _Size>::pop_front()
+template <int _Width>
+void engine<_Width>::_record_jump_latency()
 {
-    return _values[_front++ % _Size];
+    // This is the time from the jump key being pressed, to the first frame
+    // showing the jump being written out.
+    if (_jump_key_time == steady_clock::time_point{}) return;
+    const auto latency = std::chrono::duration<double, std::milli>{steady_clock::now() - _jump_key_time};
+    TRACE_COUNTER("jump latency (ms)", latency.count());
+    _jump_key_time = {};
 }
 
-template <class _Ty, int _Size>
-_Ty engine::buffer<_Ty, _Size>::operator[](const int offset) const
-{
-    return _values[(_front + offset + _Size) % _Size];
-}
+template class engine<engine_base::narrow_width>;
+template class engine<engine_base::wide_width>;
@@ -6,54 +6,142 @@
 
 #include <array>
 #include <chrono>
+#include <cstdint>
+#include <ostream>
 
+class keyboard;
 class macro_manager;
 class options;
+class replay;
+class score_table;
+struct sound_effect;
 
-class engine {
+// The parts of the engine that don't depend on the playfield width.
+class engine_base {
 public:
-    static constexpr int width = 30;
+    // The playfield columns are double width, so the narrow layout fits an
+    // 80-column screen, and the wide layout fits a 132-column screen.
+    static constexpr int narrow_width = 30;
+    static constexpr int wide_width = 60;
     static constexpr int height = 10;
+    static constexpr int max_catch_up = 8;
 
-    engine(const macro_manager& macros, const options& options);
+    // The landscape is a pure function of the seed, the game number, and the
+    // distance of each column, so any part of it can be computed directly,
+    // without generating everything that came before it. Negative distances
+    // are the columns that are already on screen when the game starts.
+    class generator {
+    public:
+        generator(const unsigned seed, const int game);
+        char ground(const int distance) const;
+        int cactus(const int distance) const;
+        int cloud(const int distance) const;
+
+    private:
+        uint64_t _random(const int stream, const int index) const;
+
+        uint64_t _key;
+    };
+
+    static int width_for(const int screen_width);
+
+protected:
+    struct column {
+        char ground = 0;
+        int cactus = 0;
+        bool cloud_step = false;
+        int cloud = -1;
+    };
+
+    template <class _Ty, int _Size>
+    class buffer {
+    public:
+        bool empty() const;
+        bool push_back(const _Ty value);
+        _Ty pop_front();
+
+    private:
+        std::array<_Ty, _Size> _values = {};
+        int _front = 0;
+        int _back = 0;
+    };
+};
+
+// The width is a template parameter, so the layout is fixed at compile
+// time. Both widths are instantiated in engine.cpp.
+template <int _Width>
+class engine : public engine_base {
+public:
+    static constexpr int width = _Width;
+    // The landscape is generated by distance from the trex column, rather
+    // than the right edge, so a cactus reaches the trex on the same tick
+    // whatever the width, and a replay plays the same on either layout. The
+    // offset is zero for the narrow layout, so its landscape is unchanged.
+    static constexpr int landscape_offset = width - narrow_width;
+
+    engine(macro_manager& macros, const options& options, replay& replay, score_table& scores, keyboard& keyboard, const generator& generator);
     bool run();
+    int frames_rendered() const;
 
 private:
+    void _advance();
+    void _advance_player();
+    void _advance_landscape(column& column);
+    void _advance_trex();
+    void _queue_sound_effects();
     void _render_landscape();
-    void _render_ground();
-    void _render_clouds();
+    bool _render_column(const column& column);
     void _render_trex();
     void _render_score();
     void _render_high_score();
-    void _play_sound_effects();
+    void _display_high_score();
+    void _relayout();
+    void _play_sound_effects(const std::chrono::steady_clock::time_point frame_end);
+    void _record_jump_latency();
 
-    const macro_manager& _macros;
+    std::ostream& _out;
+    macro_manager& _macros;
     const options& _options;
+    replay& _replay;
+    score_table& _scores;
+    keyboard& _keyboard;
+    const generator _generator;
 
     int _distance = 0;
     bool _game_over = false;
-    volatile bool _jump_pressed = false;
+    bool _jump_pressed = false;
     bool _jump_required = false;
     int _jump_time = 0;
+    int _trex_height = 0;
     std::chrono::milliseconds _frame_len;
 
-    template <class _Ty, int _Size>
-    class buffer {
-    public:
-        bool empty() const;
-        void push_back(const _Ty value);
-        _Ty pop_front();
-        _Ty operator[](const int offset) const;
+    std::array<column, max_catch_up> _columns;
+    int _column_count = 0;
+    int _frames_rendered = 0;
+    int _compose_page = 0;
+    buffer<const sound_effect*, 4> _sound_effects;
+    std::chrono::steady_clock::time_point _sound_end;
+    std::chrono::steady_clock::time_point _jump_key_time;
+};
 
-    private:
-        std::array<_Ty, _Size> _values = {};
-        int _front = 0;
-        int _back = 0;
-    };
+template <class _Ty, int _Size>
+bool engine_base::buffer<_Ty, _Size>::empty() const
+{
+    return _front >= _back;
+}
 
-    buffer<char, width> _ground_buffer;
-    buffer<int, 10> _cloud_buffer;
-    buffer<int, width * 2> _cactus_buffer;
-    int _last_cloud_pos = 0;
-    int _last_cactus_pos = 0;
-};
+template <class _Ty, int _Size>
+bool engine_base::buffer<_Ty, _Size>::push_back(const _Ty value)
+{
+    // If the buffer is full, the value is dropped rather than overwriting
+    // the oldest entry that hasn't been consumed yet.
+    if (_back - _front >= _Size) return false;
+    _values[_back++ % _Size] = value;
+    return true;
+}
+
+template <class _Ty, int _Size>
+_Ty engine_base::buffer<_Ty, _Size>::pop_front()
+{
+    return _values[_front++ % _Size];
+}
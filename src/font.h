@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <ostream>
+
 class capabilities;
 
 class soft_font {
@@ -12,5 +14,6 @@ public:
     ~soft_font();
 
 private:
+    std::ostream& _out;
     bool _has_soft_fonts;
 };
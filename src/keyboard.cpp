@@ -0,0 +1,75 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "keyboard.h"
+
+#include "options.h"
+#include "os.h"
+
+keyboard::keyboard(const options& options, const os& os)
+    : _os{os}, _state{std::make_shared<state>()}
+{
+    // In headless mode there's no keyboard, so there's nothing to read.
+    if (options.headless) return;
+    // The keyboard is read on a thread that lasts for the whole session,
+    // rather than one per game, so starting a new game doesn't allocate.
+    _thread = std::thread([state = _state, &os]() {
+        while (!state->exit_requested) {
+            const auto ch = os.getch();
+            if (ch == 32) {
+                // The time of the key press is recorded so we can measure
+                // how long it takes for the jump to reach the screen.
+                state->jump_time = std::chrono::steady_clock::now().time_since_epoch().count();
+                state->jump_pressed = true;
+            } else if (ch == 'q' || ch == 'Q' || ch == 27 || ch == 3) {
+                state->exit_requested = true;
+            } else if (ch < 0) {
+                // The connection has been closed, so there's no one to play.
+                state->exit_requested = true;
+            }
+            state->key_count++;
+            state->key_count.notify_all();
+        }
+    });
+}
+
+keyboard::~keyboard()
+{
+    // If the user hasn't requested an exit, the thread will still be blocked
+    // waiting for a key, so we interrupt that, and always join. The thread
+    // mustn't outlive the session, since the connection it's reading from
+    // could be closed, and its descriptor reused by someone else.
+    if (_thread.joinable()) {
+        _state->exit_requested = true;
+        _os.interrupt();
+        _thread.join();
+    }
+}
+
+bool keyboard::jump_pressed()
+{
+    return _state->jump_pressed.exchange(false);
+}
+
+std::chrono::steady_clock::time_point keyboard::jump_time() const
+{
+    return std::chrono::steady_clock::time_point{std::chrono::steady_clock::duration{_state->jump_time}};
+}
+
+bool keyboard::exit_requested() const
+{
+    return _state->exit_requested;
+}
+
+bool keyboard::wait_for_key()
+{
+    if (!_thread.joinable()) return true;
+    const auto key_count = _state->key_count.load();
+    if (!_state->exit_requested)
+        _state->key_count.wait(key_count);
+    // The key that was pressed shouldn't also trigger a jump in the game
+    // that follows.
+    _state->jump_pressed = false;
+    return !_state->exit_requested;
+}
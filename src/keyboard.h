@@ -0,0 +1,35 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+class options;
+class os;
+
+class keyboard {
+public:
+    keyboard(const options& options, const os& os);
+    ~keyboard();
+    bool jump_pressed();
+    std::chrono::steady_clock::time_point jump_time() const;
+    bool exit_requested() const;
+    bool wait_for_key();
+
+private:
+    struct state {
+        std::atomic<bool> jump_pressed = false;
+        std::atomic<std::chrono::steady_clock::rep> jump_time = 0;
+        std::atomic<bool> exit_requested = false;
+        std::atomic<int> key_count = 0;
+    };
+
+    const os& _os;
+    std::shared_ptr<state> _state;
+    std::thread _thread;
+};
@@ -4,57 +4,139 @@
 
 #include "macros.h"
 
+#include "allocations.h"
+#include "bundle.h"
 #include "capabilities.h"
 #include "engine.h"
 #include "options.h"
+#include "peephole.h"
+#include "profile.h"
+#include "sequences.h"
+#include "trace.h"
+#include "upload.h"
 
-#include <cstdarg>
-#include <iostream>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace {
+
+    // The macros built for each layout are shared by every session in the
+    // process, since they'd otherwise be built again for each connection.
+    std::mutex cache_mutex;
+    std::map<macro_layout, cached_macros> cache;
+
+}  // namespace
 
 macro::macro(const std::string content)
-    : _content{content}
+    : macro{content, {}, {}}
 {
 }
 
-void macro::run() const
+macro::macro(const std::string content, const std::string definition, const std::string invocation)
 {
-    std::cout << _content;
+    auto owned = std::make_shared<payload>();
+    owned->storage = content + definition + invocation;
+    const auto storage = std::string_view{owned->storage};
+    owned->content = storage.substr(0, content.length());
+    owned->definition = storage.substr(content.length(), definition.length());
+    owned->invocation = storage.substr(content.length() + definition.length());
+    _payload = std::move(owned);
 }
 
-macro_manager::macro_manager(const capabilities& caps, const options& options)
-    : _caps{caps}, _options{options}
+macro macro::mapped(const std::string_view content, const std::string_view definition, const std::string_view invocation)
 {
-    // Clear existing macros first to make sure we have space.
-    if (_caps.has_macros)
-        std::cout << "\033P0;1;0!z\033\\";
-    const auto x_indent = std::max((caps.width - engine::width * 2) / 4, 0);
-    const auto y_indent = std::max((caps.height - engine::height) / 2, 1);
-    _init_scrollers(x_indent, y_indent);
-    _init_trex(x_indent, y_indent);
-    _init_game_over_banner(x_indent, y_indent);
-    _init_high_score_label(x_indent, y_indent);
-    _init_double_width(y_indent);
-    _init_clouds();
-    _init_cactus();
-    _init_sounds();
+    auto mapped = macro{};
+    mapped._payload = std::make_shared<payload>(payload{content, definition, invocation});
+    return mapped;
 }
 
-macro_manager::~macro_manager()
+void macro::run(std::ostream& out) const
+{
+    // Until the macro has been uploaded, we output the content inline.
+    if (_payload)
+        out << (_uploaded ? _payload->invocation : _payload->content);
+}
+
+void macro::upload(std::ostream& out, const os& os)
+{
+    if (!_uploaded && _payload && !_payload->definition.empty()) {
+        upload::write(out, os, _payload->definition);
+        _uploaded = true;
+    }
+}
+
+void macro::assume_uploaded()
+{
+    if (_payload && !_payload->definition.empty())
+        _uploaded = true;
+}
+
+std::string_view macro::content() const
+{
+    return _payload ? _payload->content : std::string_view{};
+}
+
+std::string_view macro::definition() const
+{
+    return _payload ? _payload->definition : std::string_view{};
+}
+
+std::string_view macro::invocation() const
+{
+    return _payload ? _payload->invocation : std::string_view{};
+}
+
+macro_manager::macro_manager(const capabilities& caps, const options& options)
+    : _caps{caps}, _options{options}, _out{caps.output()}, _width{engine_base::width_for(caps.width)},
+      _screen_width{caps.width}, _screen_height{caps.height}, _window_size{caps.connection().query_window_size()}
 {
-    // Clean out our macros on exit.
-    if (_caps.has_macros)
-        std::cout << "\033P0;1;0!z\033\\";
+    TRACE_SCOPE("macro_manager");
+    _scroller = _choose_scroller();
+    _init_macros(true);
+    // We play a mute sound on startup to preinitialize the audio, otherwise
+    // you can get a stutter when the first sound effect is triggered.
+    if (_options.sound)
+        _out << vt::decps(0, 1, 1);
+    const auto first_frame_macros = _queue_uploads();
+    if (_caps.has_macros) {
+        // If we left our macros loaded from a previous run, and the macro
+        // space checksum is what we'd expect, they can be used as they are.
+        if (_options.keep_macros && _caps.query_macro_checksum() == _checksum) {
+            for (auto macro : _pending)
+                macro->assume_uploaded();
+            _next_pending = _pending.size();
+            return;
+        }
+        // Otherwise clear existing macros first to make sure we have space.
+        _out << "\033P0;1;0!z\033\\";
+    }
+    // The macros needed for the first frame are uploaded immediately, so the
+    // game can start as soon as possible. The rest are streamed in later.
+    while (_next_pending < first_frame_macros)
+        _pending[_next_pending++]->upload(_out, _caps.connection());
 }
 
-macro macro_manager::create(std::function<void(builder&)> callback)
+macro_manager::~macro_manager()
 {
-    auto content = builder{};
-    callback(content);
-    return create(content);
+    if (_caps.has_macros) {
+        // If we're keeping our macros loaded, we need to make sure they've
+        // all been uploaded, otherwise we clean them out on exit.
+        if (_options.keep_macros)
+            upload_pending(std::chrono::steady_clock::time_point::max());
+        else
+            _out << "\033P0;1;0!z\033\\";
+    }
 }
 
-macro macro_manager::create(const std::string_view text)
+macro macro_manager::create(const std::string_view unoptimized_text)
 {
+    // Any redundant sequences within the macro are dropped first, and the
+    // controls are converted to 8-bit form if the terminal is using them.
+    auto optimized_text = peephole{}.optimize(unoptimized_text);
+    if (_caps.has_8bit_controls)
+        optimized_text = vt::to_8bit(optimized_text);
+    const auto text = std::string_view{optimized_text};
     if (text.length() <= 5 || !_caps.has_macros) {
         return std::string{text};
     } else {
@@ -64,56 +146,314 @@ macro macro_manager::create(const std::string_view text)
             encoded[offset++] = hex[(text[i] >> 4) & 0x0F];
             encoded[offset++] = hex[text[i] & 0x0F];
         }
+        _checksum = update_checksum(_checksum, text);
         const auto id = _next_id++;
-        std::cout << "\033P" << id << ";0;1!z" << encoded << "\033\\";
-        return "\033[" + std::to_string(id) + "*z";
+        const auto definition = "\033P" + std::to_string(id) + ";0;1!z" + encoded + "\033\\";
+        return {std::string{text}, definition, std::string{vt::decinvm(id)}};
     }
 }
 
+uint16_t macro_manager::update_checksum(const uint16_t checksum, const std::string_view text)
+{
+    // The checksum is calculated the same way as the DECCKSR macro space
+    // report, so we can tell if our macros are already loaded. The terminal
+    // sums the bytes as unsigned values, which matters for 8-bit controls.
+    auto updated = checksum;
+    for (const auto ch : text)
+        updated -= static_cast<unsigned char>(ch);
+    return updated;
+}
+
+void macro_manager::upload_pending(const std::chrono::steady_clock::time_point deadline)
+{
+    // The queued macros are streamed in one at a time, for as long as there
+    // still looks to be enough time to send another one before the deadline.
+    auto upload_time = std::chrono::steady_clock::duration{};
+    while (_next_pending < _pending.size()) {
+        const auto start = std::chrono::steady_clock::now();
+        if (start + upload_time >= deadline) break;
+        _pending[_next_pending++]->upload(_out, _caps.connection());
+        _out.flush();
+        upload_time = std::chrono::steady_clock::now() - start;
+    }
+}
+
+bool macro_manager::relayout()
+{
+    // We poll the window size rather than waiting for a SIGWINCH, since the
+    // signal would be shared by every session in the process. If the size
+    // isn't known, or hasn't changed, there's nothing to do.
+    const auto window_size = _caps.connection().query_window_size();
+    if (!window_size || window_size == _window_size) return false;
+    const auto first_size = !_window_size.has_value();
+    _window_size = window_size;
+    if (first_size) return false;
+
+    const auto old_x_indent = _x_indent();
+    const auto old_y_indent = _y_indent();
+    _screen_width = window_size->width;
+    _screen_height = window_size->height;
+    if (_x_indent() == old_x_indent && _y_indent() == old_y_indent) return false;
+
+    ALLOCATION_PHASE("relayout");
+    // The macros are rebuilt for the new layout, but the position-independent
+    // macros will be identical to the ones we already have, as long as the
+    // macro ids haven't shifted, so the copies already uploaded to the
+    // terminal can stay resident. Only the layout macros are sent again,
+    // reusing the same ids. They're needed for the very next frame, so
+    // they're uploaded straight away, rather than streamed in later.
+    const auto resident = static_cast<landscape_macros>(*this);
+    const auto resident_layout_ids = _layout_ids;
+    _init_macros(false);
+    if (_layout_ids == resident_layout_ids)
+        static_cast<landscape_macros&>(*this) = resident;
+    else if (_caps.has_macros)
+        _out << "\033P0;1;0!z\033\\";
+    _pending.clear();
+    _next_pending = 0;
+    _queue_uploads();
+    upload_pending(std::chrono::steady_clock::time_point::max());
+    return true;
+}
+
+int macro_manager::compose_pages() const
+{
+    return _caps.has_page_flipping ? 2 : 1;
+}
+
+int macro_manager::playfield_width() const
+{
+    return _width;
+}
+
+scroll_strategy macro_manager::scroller() const
+{
+    return _scroller;
+}
+
+std::ostream& macro_manager::output() const
+{
+    return _out;
+}
+
+scroll_strategy macro_manager::_choose_scroller() const
+{
+    if (_options.scroller)
+        return _options.scroller.value();
+
+    auto candidates = std::vector<scroll_strategy>{};
+    if (_caps.has_horizontal_scrolling)
+        candidates.push_back(scroll_strategy::delete_column);
+    if (_caps.has_scroll_left)
+        candidates.push_back(scroll_strategy::scroll_left);
+    if (_caps.has_left_right_margins)
+        candidates.push_back(scroll_strategy::forward_index);
+    if (_caps.has_rectangle_ops)
+        candidates.push_back(scroll_strategy::copy_rectangle);
+    // Without a terminal there's nothing to time, so a headless session
+    // always uses the first strategy, which keeps its output predictable.
+    if (_options.headless || candidates.size() < 2)
+        return candidates.empty() ? scroll_strategy::delete_column : candidates.front();
+
+    // A saved profile for this terminal records which one was fastest, so
+    // we only need to time them if it hasn't been profiled yet, or is being
+    // profiled again.
+    const auto profile = _options.profile ? nullptr : terminal_profile::cached(_caps.terminal_id);
+    if (profile && profile->scroller) {
+        const auto strategy = profile->scroller.value();
+        if (std::find(candidates.begin(), candidates.end(), strategy) != candidates.end())
+            return strategy;
+    }
+
+    // We time a batch of scrolls with each strategy, waiting until the
+    // terminal has finished processing them. Page coupling is disabled while
+    // we're scrolling page 2, so there's nothing visible on the screen.
+    const auto time_batch = [&](const scroll_strategy strategy) {
+        static constexpr auto batch_size = 16;
+        auto content = builder{};
+        _add_scroll(content, strategy, 1, 10);
+        const auto start = std::chrono::steady_clock::now();
+        for (auto i = 0; i < batch_size; i++)
+            _out << std::string_view{content};
+        _caps.wait_for_output();
+        return std::chrono::steady_clock::now() - start;
+    };
+    _out << vt::decrst(64) << vt::ppa(2);
+    auto fastest = candidates.front();
+    auto fastest_time = std::chrono::steady_clock::duration::max();
+    for (const auto strategy : candidates) {
+        const auto time = time_batch(strategy);
+        if (time < fastest_time) {
+            fastest = strategy;
+            fastest_time = time;
+        }
+    }
+    _out << vt::ppa(1) << vt::decset(64);
+    return fastest;
+}
+
+void macro_manager::_add_scroll(builder& builder, const scroll_strategy strategy, const int top, const int bottom) const
+{
+    // Whichever strategy is used, the columns from 2 to 1 past the playfield
+    // width on page 2 end up moved one to the left, and since nothing is ever
+    // drawn past the playfield, the rightmost column is left blank.
+    switch (strategy) {
+        case scroll_strategy::delete_column:
+            builder.add(vt::decstbm(top, bottom), vt::decdc(), vt::decstbm());
+            break;
+        case scroll_strategy::scroll_left:
+            builder.add(vt::decstbm(top, bottom), vt::sl(), vt::decstbm());
+            break;
+        case scroll_strategy::forward_index:
+            // DECFI only scrolls when the cursor is on the right margin, so
+            // the margins are temporarily set to the bounds of the playfield.
+            builder.add(vt::decset(69), vt::decslrm(1, _width), vt::decstbm(top, bottom));
+            builder.add(vt::cup(top, _width), vt::decfi());
+            builder.add(vt::decslrm(), vt::decrst(69), vt::decstbm());
+            break;
+        case scroll_strategy::copy_rectangle:
+            builder.add(vt::deccra(top, 2, bottom, _width + 1, 2, top, 1, 2));
+            break;
+    }
+}
+
+void macro_manager::_init_macros(const bool on_startup)
+{
+    TRACE_SCOPE("_init_macros");
+    const auto x_indent = _x_indent();
+    const auto y_indent = _y_indent();
+    const auto key = macro_layout{
+        x_indent,
+        y_indent,
+        _width,
+        _caps.has_8bit_controls,
+        _caps.has_macros,
+        _caps.has_page_flipping,
+        _scroller,
+        _options.color && _caps.has_color,
+        _options.sound,
+    };
+    const auto lock = std::lock_guard{cache_mutex};
+    const auto cached = cache.find(key);
+    if (cached != cache.end()) {
+        static_cast<macro_set&>(*this) = cached->second.macros;
+        _layout_ids = cached->second.layout_ids;
+        _checksum = cached->second.checksum;
+        return;
+    }
+    // Otherwise they may have been saved in the startup bundle by an earlier
+    // launch. A headless session doesn't use the bundle, though, so replays
+    // don't depend on anything outside the executable.
+    const auto bundled = _options.headless ? std::nullopt : startup_bundle::load(key);
+    if (bundled) {
+        static_cast<macro_set&>(*this) = bundled->macros;
+        _layout_ids = bundled->layout_ids;
+        _checksum = bundled->checksum;
+        cache.emplace(key, bundled.value());
+        return;
+    }
+    // The layout macros are created first, so the ids of the macros that
+    // follow only depend on how many ids the layout required.
+    _next_id = 0;
+    _checksum = 0;
+    _init_scrollers(x_indent, y_indent);
+    _init_trex(x_indent, y_indent);
+    _init_game_over_banner(x_indent, y_indent);
+    _init_high_score_label(x_indent, y_indent);
+    _init_double_width(y_indent);
+    _layout_ids = _next_id;
+    _init_clouds();
+    _init_cactus();
+    _init_sounds();
+    const auto& built = cache.emplace(key, cached_macros{*this, _layout_ids, _checksum}).first->second;
+    // The bundle is only saved on startup, since a relayout happens in the
+    // middle of a game, where we can't afford to be writing files. A layout
+    // that's only seen after a resize will still be cached in memory.
+    if (on_startup && !_options.headless)
+        startup_bundle::save(key, built);
+}
+
+int macro_manager::_x_indent() const
+{
+    return std::max((_screen_width - _width * 2) / 4, 0);
+}
+
+int macro_manager::_y_indent() const
+{
+    return std::max((_screen_height - engine_base::height) / 2, 1);
+}
+
 void macro_manager::_init_scrollers(const int x_indent, const int y_indent)
 {
     const auto top = y_indent + 2;
     const auto bottom = y_indent + 8;
     const auto left = x_indent + 1;
-    const auto right = x_indent + engine::width;
+    const auto right = x_indent + _width;
+
+    // The scrolling sequences depend on the playfield width, but the wide
+    // layout only adds a digit here and there, so the bytes per frame are
+    // much the same.
+    const auto scroll_cursor = vt::cup(10, _width);
+
+    // Each frame is composed on page 3 before being copied to page 1. But if
+    // the terminal supports page flipping, we alternate between composing on
+    // pages 3 and 4, and just display whichever page has the latest frame.
+    const auto create_scroll_end = [&](const int page) {
+        return create([&](auto& builder) {
+            builder.add(vt::deccra(1, 1, 3, _width, 2, top, left, page));
+            builder.add(vt::deccra(7, 1, 10, _width, 2, top + 3, left, page));
+            builder.add(vt::ppa(page));
+        });
+    };
+    const auto create_scroll_end_with_clouds = [&](const int page) {
+        return create([&](auto& builder) {
+            builder.add(vt::deccra(4, 1, 10, _width, 2, top, left, page));
+            builder.add(vt::ppa(page));
+        });
+    };
+    const auto create_frame_complete = [&](const int page) {
+        return create([&](auto& builder) {
+            if (_caps.has_page_flipping) {
+                // With page coupling enabled, moving to a page makes it the
+                // visible page, but we disable it again so the landscape can
+                // be scrolled on page 2 in the background.
+                builder.add(vt::decset(64), vt::ppa(page), vt::decrst(64));
+            } else {
+                builder.add(vt::ppa(1));
+                builder.add(vt::deccra(top, left, bottom, right, page, top, left, 1));
+            }
+            builder.add(vt::cup(y_indent + 1, (x_indent + _width) * 2 - 6));
+        });
+    };
 
     scroll_start = create([&](auto& builder) {
-        builder.add("\033[2 P");
-        builder.add("\033[8;10r");
-        builder.add("\033['~");
-        builder.add("\033[r");
-        builder.add("\033[10;%dH", engine::width);
-    });
-    scroll_end = create([&](auto& builder) {
-        builder.add("\033[1;1;3;%d;2;%d;%d;3$v", engine::width, top, left);
-        builder.add("\033[7;1;10;%d;2;%d;%d;3$v", engine::width, top + 3, left);
-        builder.add("\033[3 P");
+        builder.add(vt::ppa(2));
+        _add_scroll(builder, _scroller, 8, 10);
+        builder.add(scroll_cursor);
     });
+    scroll_end[0] = create_scroll_end(3);
 
     scroll_start_with_clouds = create([&](auto& builder) {
-        builder.add("\033[2 P");
-        builder.add("\033[1;10r");
-        builder.add("\033['~");
-        builder.add("\033[r");
-        builder.add("\033[10;%dH", engine::width);
-    });
-    scroll_end_with_clouds = create([&](auto& builder) {
-        builder.add("\033[4;1;10;%d;2;%d;%d;3$v", engine::width, top, left);
-        builder.add("\033[3 P");
+        builder.add(vt::ppa(2));
+        _add_scroll(builder, _scroller, 1, 10);
+        builder.add(scroll_cursor);
     });
+    scroll_end_with_clouds[0] = create_scroll_end_with_clouds(3);
 
-    frame_complete = create([&](auto& builder) {
-        builder.add("\033[1 P");
-        builder.add("\033[%d;%d;%d;%d;3;%d;%d;1$v", top, left, bottom, right, top, left);
-        builder.add("\033[%d;%dH", y_indent + 1, (x_indent + engine::width) * 2 - 6);
-    });
+    frame_complete[0] = create_frame_complete(3);
+
+    if (compose_pages() > 1) {
+        scroll_end[1] = create_scroll_end(4);
+        scroll_end_with_clouds[1] = create_scroll_end_with_clouds(4);
+        frame_complete[1] = create_frame_complete(4);
+    }
 }
 
 void macro_manager::_init_trex(const int x_indent, const int y_indent)
 {
     auto create_trex = [&](const auto x, const auto y, const auto sprite) {
         return create([&](auto& builder) {
-            builder.add("\033[%d;%dH", y_indent + 7 - y, x_indent + x);
+            builder.add(vt::cup(y_indent + 7 - y, x_indent + x));
             builder.add(sprite);
         });
     };
@@ -134,17 +474,17 @@ void macro_manager::_init_trex(const int x_indent, const int y_indent)
 void macro_manager::_init_game_over_banner(const int x_indent, const int y_indent)
 {
     game_over_banner = create([&](auto& builder) {
-        const auto x = (engine::width - 10) / 2 + x_indent + 1;
+        const auto x = (_width - 10) / 2 + x_indent + 1;
         const auto y = y_indent + 3;
-        builder.add("\033[%d;%dHGAME  OVER", y, x);
-        builder.add("\033[%d;%dHST", y + 2, x + 4);
+        builder.add(vt::cup(y, x), "GAME  OVER");
+        builder.add(vt::cup(y + 2, x + 4), "ST");
     });
 }
 
 void macro_manager::_init_high_score_label(const int x_indent, const int y_indent)
 {
     high_score_label = create([&](auto& builder) {
-        builder.add("\033[%d;%dH", y_indent + 1, (x_indent + engine::width) * 2 - 15);
+        builder.add(vt::cup(y_indent + 1, (x_indent + _width) * 2 - 15));
         builder.add("HI ");
     });
 }
@@ -152,9 +492,9 @@ void macro_manager::_init_high_score_label(const int x_indent, const int y_inden
 void macro_manager::_init_double_width(const int y_indent)
 {
     double_width = create([&](auto& builder) {
-        builder.add("\033[%dH", y_indent + 2);
+        builder.add(vt::cup(y_indent + 2));
         for (auto i = 0; i < 7; i++)
-            builder.add("\033#6\n");
+            builder.add(vt::decdwl(), '\n');
     });
 }
 
@@ -167,9 +507,10 @@ void macro_manager::_init_clouds()
             const auto ch1 = "{@}"[cloud_type];
             const auto ch2 = "(?)"[cloud_type];
             cloud_parts[index] = create([&](auto& builder) {
-                if (using_color) builder.add("\033[44m");
-                builder.add("\033[%d;%dH%c\b\033M\033M\033M%c", 6 - cloud_height, engine::width, ch1, ch2);
-                if (using_color) builder.add("\033[m");
+                if (using_color) builder.add(vt::sgr(44));
+                builder.add(vt::cup(6 - cloud_height, _width), ch1, '\b');
+                builder.add(vt::ri(), vt::ri(), vt::ri(), ch2);
+                if (using_color) builder.add(vt::sgr());
             });
         }
     }
@@ -193,26 +534,79 @@ void macro_manager::_init_cactus()
 void macro_manager::_init_sounds()
 {
     if (_options.sound) {
-        game_over_sound = create("\033[4;1;1,~\033[4;1;0,~\033[4;1;1,~");
-        jump_sound = create("\033[2;1;3,~");
-        score_sound[0] = create("\033[4;1;3,~");
-        score_sound[1] = create("\033[4;2;10,~");
-        // We play a mute sound on startup to preinitialize the audio, otherwise
-        // you can get a stutter when the first sound effect is triggered.
-        std::cout << "\033[0;1;1,~";
+        game_over_sound = _create_sound({{4, 1, 1}, {4, 1, 0}, {4, 1, 1}});
+        jump_sound = _create_sound({{2, 1, 3}});
+        score_sound[0] = _create_sound({{4, 1, 3}});
+        score_sound[1] = _create_sound({{4, 2, 10}});
     }
 }
 
-void macro_manager::builder::add(const char* fmt...)
+sound_effect macro_manager::_create_sound(const std::initializer_list<std::array<int, 3>> notes)
+{
+    auto sound = sound_effect{};
+    sound.notes = create([&](auto& builder) {
+        for (const auto [volume, duration, note] : notes) {
+            builder.add(vt::decps(volume, duration, note));
+            sound.duration += decltype(sound.duration){duration};
+        }
+    });
+    return sound;
+}
+
+size_t macro_manager::_queue_uploads()
+{
+    // The macros are queued in the order they're likely to be needed, with
+    // those required for the first frame at the front. The rest are streamed
+    // in during the slack time at the end of the early frames, and until then
+    // they're output inline.
+    _queue(scroll_start);
+    _queue(scroll_end);
+    _queue(scroll_start_with_clouds);
+    _queue(scroll_end_with_clouds);
+    _queue(frame_complete);
+    _queue(trex_standing);
+    _queue(trex_running);
+    const auto first_frame_macros = _pending.size();
+    _queue(trex_jumping);
+    _queue(cactus_parts);
+    _queue(cloud_parts);
+    _queue(jump_sound);
+    _queue(trex_dead);
+    _queue(game_over_banner);
+    _queue(game_over_sound);
+    _queue(high_score_label);
+    _queue(score_sound);
+    _queue(double_width);
+    return first_frame_macros;
+}
+
+template <class _Ty, size_t _Size>
+void macro_manager::_queue(std::array<_Ty, _Size>& macros)
+{
+    for (auto& macro : macros)
+        _queue(macro);
+}
+
+void macro_manager::_queue(macro& macro)
+{
+    _pending.push_back(&macro);
+}
+
+void macro_manager::_queue(sound_effect& sound)
+{
+    _queue(sound.notes);
+}
+
+void macro_manager::builder::_append(const std::string_view text)
 {
-    va_list args;
-    va_start(args, fmt);
-    char text[1024];
-    vsnprintf(text, sizeof text, fmt, args);
-    va_end(args);
     _buffer.append(text);
 }
 
+void macro_manager::builder::_append(const char ch)
+{
+    _buffer.push_back(ch);
+}
+
 macro_manager::builder::operator std::string_view() const
 {
     return _buffer;
@@ -4,37 +4,70 @@
 
 #pragma once
 
+#include "options.h"
+#include "os.h"
+
 #include <array>
-#include <functional>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <ratio>
 #include <string>
 #include <string_view>
+#include <vector>
 
 class capabilities;
-class options;
 
 class macro {
 public:
     macro() = default;
     macro(const std::string content);
-    void run() const;
+    macro(const std::string content, const std::string definition, const std::string invocation);
+    static macro mapped(const std::string_view content, const std::string_view definition, const std::string_view invocation);
+    void run(std::ostream& out) const;
+    void upload(std::ostream& out, const os& os);
+    void assume_uploaded();
+    std::string_view content() const;
+    std::string_view definition() const;
+    std::string_view invocation() const;
 
 private:
-    std::string _content;
+    // The content is immutable once the macro has been created, so it can be
+    // shared by every session with the same layout. Only the upload state is
+    // specific to a session. A mapped macro references the startup bundle,
+    // which stays mapped for the life of the process, so it has no storage
+    // of its own.
+    struct payload {
+        std::string_view content;
+        std::string_view definition;
+        std::string_view invocation;
+        std::string storage;
+    };
+
+    std::shared_ptr<const payload> _payload;
+    bool _uploaded = false;
 };
 
-class macro_manager {
-public:
-    class builder;
-    macro_manager(const capabilities& caps, const options& options);
-    ~macro_manager();
-    macro create(std::function<void(builder&)> callback);
-    macro create(const std::string_view text);
+// DECPS blocks the terminal while the sound is playing, so we need to know
+// how long each effect will take. The duration is in 1/32 second units, as
+// used by DECPS itself.
+struct sound_effect {
+    macro notes;
+    std::chrono::duration<int, std::ratio<1, 32>> duration = {};
+};
 
+// These macros depend on where the playfield is positioned on the screen, so
+// they have to be regenerated whenever the screen size changes.
+struct layout_macros {
     macro scroll_start;
-    macro scroll_end;
+    std::array<macro, 2> scroll_end;
     macro scroll_start_with_clouds;
-    macro scroll_end_with_clouds;
-    macro frame_complete;
+    std::array<macro, 2> scroll_end_with_clouds;
+    std::array<macro, 2> frame_complete;
     std::array<macro, 2> trex_running;
     std::array<macro, 9> trex_jumping;
     std::array<macro, 3> trex_dead;
@@ -42,13 +75,43 @@ public:
     macro game_over_banner;
     macro high_score_label;
     macro double_width;
+};
+
+// The rest are positioned relative to the landscape on page 2, or have no
+// position at all, so they're unaffected by the screen size.
+struct landscape_macros {
     std::array<macro, 9> cloud_parts;
     std::array<macro, 12> cactus_parts;
-    macro game_over_sound;
-    macro jump_sound;
-    std::array<macro, 2> score_sound;
+    sound_effect game_over_sound;
+    sound_effect jump_sound;
+    std::array<sound_effect, 2> score_sound;
+};
+
+struct macro_set : layout_macros, landscape_macros {
+};
+
+class macro_manager : public macro_set {
+public:
+    class builder;
+    macro_manager(const capabilities& caps, const options& options);
+    ~macro_manager();
+    template <std::invocable<builder&> Callback>
+    macro create(const Callback& callback);
+    macro create(const std::string_view text);
+    static uint16_t update_checksum(const uint16_t checksum, const std::string_view text);
+    void upload_pending(const std::chrono::steady_clock::time_point deadline);
+    bool relayout();
+    int compose_pages() const;
+    int playfield_width() const;
+    scroll_strategy scroller() const;
+    std::ostream& output() const;
 
 private:
+    scroll_strategy _choose_scroller() const;
+    void _add_scroll(builder& builder, const scroll_strategy strategy, const int top, const int bottom) const;
+    void _init_macros(const bool on_startup);
+    int _x_indent() const;
+    int _y_indent() const;
     void _init_scrollers(const int x_indent, const int y_indent);
     void _init_trex(const int x_indent, const int y_indent);
     void _init_game_over_banner(const int x_indent, const int y_indent);
@@ -57,17 +120,52 @@ private:
     void _init_clouds();
     void _init_cactus();
     void _init_sounds();
+    sound_effect _create_sound(const std::initializer_list<std::array<int, 3>> notes);
+    size_t _queue_uploads();
+
+    template <class _Ty, size_t _Size>
+    void _queue(std::array<_Ty, _Size>& macros);
+    void _queue(macro& macro);
+    void _queue(sound_effect& sound);
 
     const capabilities& _caps;
     const options& _options;
+    std::ostream& _out;
+    int _width = 0;
+    int _screen_width = 0;
+    int _screen_height = 0;
+    std::optional<os::window_size> _window_size;
+    scroll_strategy _scroller = scroll_strategy::delete_column;
     int _next_id = 0;
+    int _layout_ids = 0;
+    uint16_t _checksum = 0;
+    std::vector<macro*> _pending;
+    size_t _next_pending = 0;
 };
 
 class macro_manager::builder {
 public:
-    void add(const char* fmt...);
+    template <typename... Args>
+    void add(const Args&... args);
     operator std::string_view() const;
 
 private:
+    void _append(const std::string_view text);
+    void _append(const char ch);
+
     std::string _buffer;
 };
+
+template <typename... Args>
+void macro_manager::builder::add(const Args&... args)
+{
+    (_append(args), ...);
+}
+
+template <std::invocable<macro_manager::builder&> Callback>
+macro macro_manager::create(const Callback& callback)
+{
+    auto content = builder{};
+    callback(content);
+    return create(std::string_view{content});
+}
@@ -2,34 +2,61 @@
 // Copyright (c) 2024 James Holderness
 // Distributed under the MIT License
 
-#include "capabilities.h"
-#include "coloring.h"
-#include "engine.h"
-#include "font.h"
-#include "macros.h"
+#include "allocations.h"
 #include "options.h"
 #include "os.h"
+#include "scores.h"
+#include "server.h"
+#include "session.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
 #include <iostream>
+#include <list>
+#include <thread>
+#include <vector>
 
-bool check_compatibility(const capabilities& caps, const options& options)
+bool run_sessions(std::list<session>& sessions)
 {
-    const auto compatible =
-        caps.has_soft_fonts &&
-        caps.has_horizontal_scrolling &&
-        caps.has_rectangle_ops &&
-        caps.has_pages;
-    if (!compatible && !options.yolo) {
-        std::cout << "VT-Rex requires a VT420-compatible terminal or better.\n";
-        std::cout << "Try 'vtrex --yolo' to bypass the compatibility checks.\n";
-        return false;
-    }
-    if (caps.height < engine::height) {
-        std::cout << "VT-Rex requires a minimum screen height of " << engine::height << ".\n";
-        return false;
+    // A single session is run on the main thread. For a load test, the
+    // sessions are all run at once, each on a thread of its own.
+    if (sessions.size() == 1)
+        return sessions.front().run();
+    auto results = std::vector<char>(sessions.size());
+    auto threads = std::vector<std::thread>{};
+    auto index = 0;
+    for (auto& load_session : sessions)
+        threads.emplace_back([&, i = index++]() { results[i] = load_session.run(); });
+    for (auto& thread : threads)
+        thread.join();
+    return std::all_of(results.begin(), results.end(), [](const auto result) { return result; });
+}
+
+bool report_stats(const options& options, const std::list<session>& sessions)
+{
+    auto startup_bytes = uint64_t{0};
+    auto frame_bytes = uint64_t{0};
+    auto frames = 0;
+    auto bytes_dropped = uint64_t{0};
+    for (const auto& session : sessions) {
+        startup_bytes += session.startup_bytes();
+        frame_bytes += session.frame_bytes();
+        frames += session.frames_rendered();
+        bytes_dropped += session.bytes_dropped();
     }
-    if (caps.width < engine::width * 2) {
-        std::cout << "VT-Rex requires a minimum screen width of " << engine::width * 2 << ".\n";
+    // The standard output is discarded in headless mode, so the report is
+    // written to stderr.
+    const auto bytes_per_frame = frames > 0 ? double(frame_bytes) / frames : 0.0;
+    if (sessions.size() > 1)
+        std::cerr << "Sessions:         " << sessions.size() << "\n";
+    std::cerr << "Frames rendered:  " << frames << "\n";
+    std::cerr << "Startup bytes:    " << startup_bytes << "\n";
+    std::cerr << "Frame bytes:      " << frame_bytes << "\n";
+    std::cerr << "Bytes per frame:  " << std::fixed << std::setprecision(1) << bytes_per_frame << "\n";
+    std::cerr << "Peephole dropped: " << bytes_dropped << "\n";
+    if (options.budget && bytes_per_frame > options.budget.value()) {
+        std::cerr << "VT-Rex: output exceeds the budget of " << options.budget.value() << " bytes per frame\n";
         return false;
     }
     return true;
@@ -43,67 +70,38 @@ int main(const int argc, const char* argv[])
     if (options.exit)
         return 1;
 
-    capabilities caps;
-    if (!check_compatibility(caps, options))
-        return 1;
+    score_table scores(options);
+    if (options.show_scores) {
+        const auto top = scores.top();
+        for (auto i = 0; i < top.size() && top[i] > 0; i++)
+            std::cout << std::setw(2) << (i + 1) << ". " << std::setfill('0') << std::setw(5) << top[i] << std::setfill(' ') << "\n";
+        return 0;
+    }
 
-    // Set the window title.
-    std::cout << "\033]21;VT-Rex\033\\";
-    // Load the soft font.
-    const auto font = soft_font{caps};
-    // Initialize the macros.
-    const auto macros = macro_manager{caps, options};
-    // Setup the color assignment and palette.
-    const auto colors = coloring{caps, options};
-    // Save the modes and settings that we're going to change.
-    const auto original_decscnm = caps.query_mode(5);
-    const auto original_decawm = caps.query_mode(7);
-    const auto original_decssdt = caps.query_setting("$~");
-    // Reverse screen attributes so it's effectively black on white.
-    std::cout << "\033[?5h";
-    // Disable line wrapping.
-    std::cout << "\033[?7l";
-    // Disable page cursor coupling.
-    std::cout << "\033[?64l";
-    // Hide the status line.
-    std::cout << "\033[0$~";
-    // Clear margins.
-    std::cout << "\033[r";
-    // Set default attributes.
-    std::cout << "\033[m";
-    // Clear the screen.
-    std::cout << "\033[2J";
-    // Hide the cursor.
-    std::cout << "\033[?25l";
-    // Make the play area double width
-    macros.double_width.run();
+    if (!options.serve.empty()) {
+        auto session_server = server{options, scores, os};
+        return session_server.run() ? 0 : 1;
+    }
 
-    while (true) {
-        auto game_engine = engine{macros, options};
-        if (!game_engine.run()) break;
+    // Normally there's a single session on the console, but for a headless
+    // load test there can be any number, and since their output is going to
+    // be discarded, they just need a stream of their own to write to.
+    auto streams = std::list<std::ostream>{};
+    auto sessions = std::list<session>{};
+    for (auto i = 0; i < options.sessions; i++) {
+        auto& out = options.sessions == 1 ? std::cout : streams.emplace_back(nullptr);
+        sessions.emplace_back(options, scores, os, out);
     }
+    if (!run_sessions(sessions))
+        return 1;
 
-    // Clear the window title.
-    std::cout << "\033]21;\033\\";
-    // Set default attributes.
-    std::cout << "\033[m";
-    // Clear all pages.
-    std::cout << "\033[3 P\033[2J";
-    std::cout << "\033[2 P\033[2J";
-    std::cout << "\033[1 P\033[H\033[J";
-    // Make sure page 1 is visible.
-    std::cout << "\033[?64h";
-    // Reset reverse screen attributes if not originally set.
-    if (original_decscnm != true)
-        std::cout << "\033[?5l";
-    // Reapply line wrapping if not originally reset.
-    if (original_decawm != false)
-        std::cout << "\033[?7h";
-    // Restore the original status display type.
-    if (!original_decssdt.empty())
-        std::cout << "\033[" << original_decssdt;
-    // Show the cursor.
-    std::cout << "\033[?25h";
+    if (!ALLOCATION_REPORT())
+        return 1;
+
+    if (options.stats) {
+        if (!report_stats(options, sessions))
+            return 1;
+    }
 
     return 0;
 }
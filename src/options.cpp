@@ -5,9 +5,30 @@
 #include "options.h"
 
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <string>
 
+namespace {
+
+    // The strategies are named after the control sequence that does the
+    // actual scrolling.
+    constexpr auto scroll_strategy_names = std::array{"decdc", "sl", "decfi", "deccra"};
+
+}  // namespace
+
+std::string_view to_string(const scroll_strategy strategy)
+{
+    return scroll_strategy_names[static_cast<int>(strategy)];
+}
+
+std::optional<scroll_strategy> parse_scroll_strategy(const std::string_view name)
+{
+    const auto match = std::find(scroll_strategy_names.begin(), scroll_strategy_names.end(), name);
+    if (match == scroll_strategy_names.end()) return {};
+    return static_cast<scroll_strategy>(match - scroll_strategy_names.begin());
+}
+
 options::options(const int argc, const char* argv[])
 {
     for (auto i = 1; i < argc; i++) {
@@ -20,6 +41,10 @@ options::options(const int argc, const char* argv[])
             blink = false;
         } else if (arg == "--yolo") {
             yolo = true;
+        } else if (arg == "--8bit") {
+            eight_bit = true;
+        } else if (arg == "--keep-macros") {
+            keep_macros = true;
         } else if (arg == "--speed" && i + 1 < argc) {
             try {
                 fps = std::stoi(argv[++i]);
@@ -27,13 +52,75 @@ options::options(const int argc, const char* argv[])
             } catch (std::exception) {
                 // ignore invalid speed
             }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            try {
+                seed = std::stoul(argv[++i]);
+            } catch (std::exception) {
+                // ignore invalid seed
+            }
+        } else if (arg == "--scroll" && i + 1 < argc) {
+            const auto name = std::string_view{argv[++i]};
+            scroller = parse_scroll_strategy(name);
+            if (!scroller) {
+                std::cout << "VT-Rex: unknown scroll method '" << name << "'\n";
+                exit = true;
+            }
+        } else if (arg == "--record" && i + 1 < argc) {
+            record = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replay = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serve = argv[++i];
+        } else if (arg == "--sessions" && i + 1 < argc) {
+            try {
+                sessions = std::stoi(argv[++i]);
+                sessions = std::clamp(sessions, 1, 10000);
+            } catch (std::exception) {
+                // ignore invalid session count
+            }
+        } else if (arg == "--columns" && i + 1 < argc) {
+            try {
+                columns = std::clamp(std::stoi(argv[++i]), 60, 255);
+            } catch (std::exception) {
+                // ignore invalid column count
+            }
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--budget" && i + 1 < argc) {
+            try {
+                budget = std::stod(argv[++i]);
+                stats = true;
+            } catch (std::exception) {
+                // ignore invalid budget
+            }
+        } else if (arg == "--scores") {
+            show_scores = true;
+        } else if (arg == "--profile") {
+            profile = true;
         } else if (arg == "--help") {
             std::cout << "Usage: vtrex [OPTION]...\n\n";
             std::cout << "  --mono        no coloring\n";
             std::cout << "  --mute        no sound effects\n";
             std::cout << "  --noblink     no blinking effects\n";
             std::cout << "  --speed FPS   set initial speed (1 to 30)\n";
+            std::cout << "  --8bit        use 8-bit C1 controls if the link supports it\n";
+            std::cout << "  --keep-macros leave macros loaded for a faster restart\n";
             std::cout << "  --yolo        bypass compatibility checks\n";
+            std::cout << "  --seed N      set the random seed for the landscape\n";
+            std::cout << "  --scroll NAME scroll with decdc, sl, decfi, or deccra, rather than\n";
+            std::cout << "                whichever the terminal executes fastest\n";
+            std::cout << "  --record FILE record the seed and jumps to a replay file\n";
+            std::cout << "  --replay FILE play back a recorded replay file\n";
+            std::cout << "  --serve PATH  serve sessions to terminals connecting on a Unix socket\n";
+            std::cout << "  --headless    run a replay without a terminal at full speed\n";
+            std::cout << "  --sessions N  run N concurrent headless sessions as a load test\n";
+            std::cout << "  --columns N   set the screen width of a headless replay (default 80)\n";
+            std::cout << "  --stats       report the output size of a headless replay\n";
+            std::cout << "  --budget N    fail if a headless replay exceeds N bytes per frame\n";
+            std::cout << "  --scores      display the high score table and exit\n";
+            std::cout << "  --profile     time the terminal's execution of each macro and exit\n";
             std::cout << "  --help        display this help and exit\n";
             exit = true;
         } else {
@@ -42,4 +129,28 @@ options::options(const int argc, const char* argv[])
             exit = true;
         }
     }
+    if (headless && replay.empty()) {
+        std::cout << "VT-Rex: option '--headless' requires '--replay'\n";
+        exit = true;
+    }
+    if (profile && headless) {
+        std::cout << "VT-Rex: option '--profile' requires a terminal\n";
+        exit = true;
+    }
+    if (columns && !headless) {
+        std::cout << "VT-Rex: option '--columns' requires '--headless'\n";
+        exit = true;
+    }
+    if (sessions > 1 && !headless) {
+        std::cout << "VT-Rex: option '--sessions' requires '--headless'\n";
+        exit = true;
+    }
+    if (!serve.empty() && (headless || profile || !record.empty() || !replay.empty())) {
+        std::cout << "VT-Rex: option '--serve' can only be used for live games\n";
+        exit = true;
+    }
+    if (stats && !headless) {
+        std::cout << "VT-Rex: option '" << (budget ? "--budget" : "--stats") << "' requires '--headless'\n";
+        exit = true;
+    }
 }
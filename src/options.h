@@ -4,6 +4,21 @@
 
 #pragma once
 
+#include <optional>
+#include <string>
+#include <string_view>
+
+// The different ways of scrolling the landscape one column to the left.
+enum class scroll_strategy {
+    delete_column,
+    scroll_left,
+    forward_index,
+    copy_rectangle,
+};
+
+std::string_view to_string(const scroll_strategy strategy);
+std::optional<scroll_strategy> parse_scroll_strategy(const std::string_view name);
+
 class options {
 public:
     options(const int argc, const char* argv[]);
@@ -13,5 +28,19 @@ public:
     bool blink = true;
     bool yolo = false;
     bool exit = false;
+    bool show_scores = false;
+    bool profile = false;
+    bool keep_macros = false;
+    bool eight_bit = false;
     int fps = 15;
+    bool headless = false;
+    bool stats = false;
+    std::optional<double> budget;
+    std::optional<unsigned> seed;
+    std::optional<scroll_strategy> scroller;
+    std::string record;
+    std::string replay;
+    std::string serve;
+    int sessions = 1;
+    std::optional<int> columns;
 };
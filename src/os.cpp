@@ -4,21 +4,28 @@
 
 #include "os.h"
 
+#include <cstdlib>
+
 #ifdef _WIN32
 
 #include <Windows.h>
 
-DWORD output_mode;
-DWORD input_mode;
+#include <cstdio>
+
+struct os::state {
+    DWORD output_mode;
+    DWORD input_mode;
+};
 
 os::os()
+    : _state{std::make_unique<state>()}
 {
     HANDLE output_handle = GetStdHandle(STD_OUTPUT_HANDLE);
-    GetConsoleMode(output_handle, &output_mode);
-    SetConsoleMode(output_handle, output_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING | DISABLE_NEWLINE_AUTO_RETURN);
+    GetConsoleMode(output_handle, &_state->output_mode);
+    SetConsoleMode(output_handle, _state->output_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING | DISABLE_NEWLINE_AUTO_RETURN);
     HANDLE input_handle = GetStdHandle(STD_INPUT_HANDLE);
-    GetConsoleMode(input_handle, &input_mode);
-    SetConsoleMode(input_handle, input_mode & ~ENABLE_LINE_INPUT & ~ENABLE_ECHO_INPUT & ~ENABLE_PROCESSED_INPUT | ENABLE_VIRTUAL_TERMINAL_INPUT);
+    GetConsoleMode(input_handle, &_state->input_mode);
+    SetConsoleMode(input_handle, _state->input_mode & ~ENABLE_LINE_INPUT & ~ENABLE_ECHO_INPUT & ~ENABLE_PROCESSED_INPUT | ENABLE_VIRTUAL_TERMINAL_INPUT);
     // We're trapping and ignoring Ctrl+Break events so the app doesn't abort
     // with the terminal in an unusable state.
     SetConsoleCtrlHandler([](DWORD) { return TRUE; }, TRUE);
@@ -27,47 +34,150 @@ os::os()
 os::~os()
 {
     HANDLE output_handle = GetStdHandle(STD_OUTPUT_HANDLE);
-    SetConsoleMode(output_handle, output_mode);
+    SetConsoleMode(output_handle, _state->output_mode);
     HANDLE input_handle = GetStdHandle(STD_INPUT_HANDLE);
-    SetConsoleMode(input_handle, input_mode);
+    SetConsoleMode(input_handle, _state->input_mode);
 }
 
-int os::getch()
+int os::getch() const
 {
     char ch;
     DWORD chars_read = 0;
     HANDLE input_handle = GetStdHandle(STD_INPUT_HANDLE);
     ReadConsoleA(input_handle, &ch, 1, &chars_read, NULL);
-    return chars_read == 1 ? static_cast<int>(ch) : -1;
+    return chars_read == 1 ? static_cast<unsigned char>(ch) : -1;
+}
+
+void os::interrupt() const
+{
+    // This cancels a read that's blocked in getch, which then returns -1.
+    CancelIoEx(GetStdHandle(STD_INPUT_HANDLE), NULL);
 }
+
+void os::drain() const
+{
+    fflush(stdout);
+}
+
+std::optional<os::window_size> os::query_window_size() const
+{
+    auto info = CONSOLE_SCREEN_BUFFER_INFO{};
+    if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+        return {};
+    const auto width = info.srWindow.Right - info.srWindow.Left + 1;
+    const auto height = info.srWindow.Bottom - info.srWindow.Top + 1;
+    return window_size{width, height};
+}
+
 #endif
 
 #ifdef __linux__
 
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
+#include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstdio>
 
-struct termios term_attributes;
+struct os::state {
+    int input_fd;
+    int output_fd;
+    bool is_tty;
+    struct termios attributes;
+    int wake_fds[2] = {-1, -1};
+};
 
 os::os()
+    : os(STDIN_FILENO, STDOUT_FILENO)
+{
+}
+
+os::os(const int input_fd, const int output_fd)
+    : _state{std::make_unique<state>(state{input_fd, output_fd})}
 {
-    tcgetattr(STDIN_FILENO, &term_attributes);
-    auto new_term_attributes = term_attributes;
-    new_term_attributes.c_lflag &= ~(ICANON | ISIG | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &new_term_attributes);
+    // A socket has no terminal modes, so there's nothing to change there.
+    _state->is_tty = tcgetattr(input_fd, &_state->attributes) == 0;
+    if (_state->is_tty) {
+        auto new_term_attributes = _state->attributes;
+        new_term_attributes.c_lflag &= ~(ICANON | ISIG | ECHO);
+        // We rely on the tty driver to handle XON/XOFF flow control, suspending
+        // our output when the terminal sends XOFF, and resuming it on XON. This
+        // is usually the default, but we make sure of it here.
+        new_term_attributes.c_iflag |= IXON;
+        tcsetattr(input_fd, TCSANOW, &new_term_attributes);
+    }
+    // The wake pipe lets another thread interrupt a blocked getch.
+    pipe2(_state->wake_fds, O_CLOEXEC);
 }
 
 os::~os()
 {
-    tcsetattr(STDIN_FILENO, TCSANOW, &term_attributes);
+    if (_state->is_tty)
+        tcsetattr(_state->input_fd, TCSANOW, &_state->attributes);
+    for (const auto fd : _state->wake_fds)
+        if (fd >= 0) close(fd);
+}
+
+int os::getch() const
+{
+    unsigned char ch;
+    for (;;) {
+        pollfd fds[] = {{_state->input_fd, POLLIN, 0}, {_state->wake_fds[0], POLLIN, 0}};
+        const auto ready = poll(fds, 2, -1);
+        if (ready < 0 && errno == EINTR) continue;
+        // The wake byte is never read, so once interrupted, every later
+        // call returns immediately too.
+        if (ready < 0 || fds[1].revents) return -1;
+        const auto result = read(_state->input_fd, &ch, 1);
+        if (result == 1) return ch;
+        if (result < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        return -1;
+    }
 }
 
-int os::getch()
+void os::interrupt() const
 {
-    return getchar();
+    const auto wake = char{0};
+    if (_state->wake_fds[1] >= 0)
+        write(_state->wake_fds[1], &wake, 1);
+}
+
+void os::drain() const
+{
+    // This waits until everything we've written has been transmitted, which
+    // will include any time that the output is suspended by flow control.
+    if (_state->output_fd == STDOUT_FILENO)
+        fflush(stdout);
+    tcdrain(_state->output_fd);
+}
+
+std::optional<os::window_size> os::query_window_size() const
+{
+    // This only works for a pty, or a tty that has had its size configured.
+    // A size of zero means that it isn't known.
+    auto size = winsize{};
+    if (ioctl(_state->output_fd, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0)
+        return {};
+    return window_size{size.ws_col, size.ws_row};
 }
 
 #endif
+
+std::string os::home_path(const char* env_name, const char* filename)
+{
+    // The environment variable can override the default location, which is
+    // a file in the user's home directory.
+    if (const auto path = std::getenv(env_name))
+        return path;
+#ifdef _WIN32
+    const auto home = std::getenv("USERPROFILE");
+    return home ? std::string{home} + "\\" + filename : "";
+#else
+    const auto home = std::getenv("HOME");
+    return home ? std::string{home} + "/" + filename : "";
+#endif
+}
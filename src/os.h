@@ -4,9 +4,35 @@
 
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <string>
+
+// Each session has its own os instance, which holds the terminal connection
+// and the modes that need to be restored when the session ends. By default
+// that's the console, but on Linux it can also be any other pair of file
+// descriptors, like a pty or a socket.
+
 class os {
 public:
+    struct window_size {
+        int width;
+        int height;
+        bool operator==(const window_size&) const = default;
+    };
+
     os();
+#ifdef __linux__
+    os(const int input_fd, const int output_fd);
+#endif
     ~os();
-    static int getch();
+    int getch() const;
+    void interrupt() const;
+    void drain() const;
+    std::optional<window_size> query_window_size() const;
+    static std::string home_path(const char* env_name, const char* filename);
+
+private:
+    struct state;
+    std::unique_ptr<state> _state;
 };
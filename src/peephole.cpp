@@ -0,0 +1,371 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "peephole.h"
+
+#include <charconv>
+
+// The peephole optimizer tracks the terminal state that the output sequences
+// depend on (the active page, the rendition, and the cursor position), and
+// drops any sequences that wouldn't change that state. It also drops a CUP,
+// PPA, DECSTBM, or SGR when it's immediately superseded by another sequence
+// of the same kind. The macro definitions are tracked too, so that state can
+// be followed across macro invocations.
+//
+// Anything that isn't fully understood invalidates the tracked state, so the
+// worst case is that nothing is optimized.
+
+using kind = peephole::token::kind;
+
+namespace {
+
+    bool is_csi(const peephole::token& token, const std::string_view final)
+    {
+        return token.type == kind::csi && token.final == final;
+    }
+
+    bool is_sgr_default(const peephole::token& token)
+    {
+        return token.params.empty() || token.params == "0";
+    }
+
+    bool is_sgr_reset(const peephole::token& token)
+    {
+        const auto& params = token.params;
+        return is_sgr_default(token) || params.starts_with("0;") || params.starts_with(";");
+    }
+
+    int first_param(const peephole::token& token, const int default_value)
+    {
+        auto value = default_value;
+        const auto& params = token.params;
+        std::from_chars(params.data(), params.data() + params.size(), value);
+        return value;
+    }
+
+}  // namespace
+
+bool peephole::tokenizer::parse(const char ch)
+{
+    if (_state == state::ground) {
+        _token.bytes.clear();
+        _token.params.clear();
+        _token.final.clear();
+        _token.emitted = 0;
+    }
+    _token.bytes += ch;
+    const auto uch = static_cast<unsigned char>(ch);
+    switch (_state) {
+        case state::ground:
+            if (ch == '\033') {
+                _state = state::escape;
+                return false;
+            }
+            if (uch == 0x9B) {
+                _state = state::csi;
+                return false;
+            }
+            if (uch == 0x90 || uch == 0x9D) {
+                _token.type = uch == 0x90 ? kind::dcs : kind::osc;
+                _state = state::string;
+                return false;
+            }
+            _token.type = (uch < 0x20 || (uch >= 0x7F && uch < 0xA0)) ? kind::control : kind::text;
+            return true;
+        case state::escape:
+            if (ch == '[') {
+                _state = state::csi;
+                return false;
+            }
+            if (ch == 'P' || ch == ']') {
+                _token.type = ch == 'P' ? kind::dcs : kind::osc;
+                _state = state::string;
+                return false;
+            }
+            _token.final += ch;
+            if (uch >= 0x20 && uch <= 0x2F) return false;
+            return _complete(kind::esc);
+        case state::csi:
+            if (uch >= 0x30 && uch <= 0x3F && _token.final.empty()) {
+                _token.params += ch;
+                return false;
+            }
+            _token.final += ch;
+            if (uch >= 0x40 && uch <= 0x7E) return _complete(kind::csi);
+            return false;
+        case state::string:
+            if (ch == '\033') _state = state::string_escape;
+            if (uch == 0x9C || (ch == '\007' && _token.type == kind::osc)) return _complete(_token.type);
+            return false;
+        case state::string_escape:
+            if (ch == '\\') return _complete(_token.type);
+            _state = ch == '\033' ? state::string_escape : state::string;
+            return false;
+    }
+    return false;
+}
+
+bool peephole::tokenizer::pending() const
+{
+    return _state != state::ground;
+}
+
+peephole::token& peephole::tokenizer::current()
+{
+    return _token;
+}
+
+bool peephole::tokenizer::_complete(const token::kind type)
+{
+    _token.type = type;
+    _state = state::ground;
+    return true;
+}
+
+std::string peephole::optimize(const std::string_view text)
+{
+    auto output = std::string{};
+    write(text, output);
+    flush(output);
+    return output;
+}
+
+void peephole::write(const std::string_view text, std::string& output)
+{
+    for (const auto ch : text) {
+        if (_tokenizer.parse(ch))
+            _process(_tokenizer.current(), output);
+    }
+}
+
+void peephole::flush(std::string& output)
+{
+    if (_held) {
+        _emit(*_held, output);
+        _held.reset();
+    }
+    // If we're in the middle of a sequence, whatever we have so far must be
+    // written out, and the rest will be passed through unoptimized.
+    if (_tokenizer.pending()) {
+        auto& token = _tokenizer.current();
+        output.append(token.bytes, token.emitted);
+        token.emitted = token.bytes.length();
+    }
+}
+
+std::optional<peephole::macro_definition> peephole::parse_macro(const std::string_view bytes)
+{
+    // DECDMAC: DCS Pid ; Pdt ; Pen ! z D...D ST
+    const auto introducer = bytes[0] == '\033' ? 2 : 1;
+    const auto terminator = bytes.back() == '\\' ? 2 : 1;
+    const auto params_end = bytes.find_first_not_of("0123456789;", introducer);
+    if (params_end == std::string::npos || bytes.compare(params_end, 2, "!z") != 0)
+        return {};
+    const auto body_start = params_end + 2;
+    const auto params = bytes.substr(introducer, params_end - introducer);
+    const auto body = bytes.substr(body_start, bytes.length() - terminator - body_start);
+
+    int values[3] = {0, 0, 0};
+    auto index = 0;
+    for (auto p = params.data(); p < params.data() + params.size() && index < 3; index++) {
+        p = std::from_chars(p, params.data() + params.size(), values[index]).ptr;
+        if (p < params.data() + params.size() && *p == ';') p++;
+    }
+    const auto [id, delete_all, encoding] = values;
+
+    auto definition = macro_definition{id, delete_all == 1};
+    if (encoding == 1) {
+        for (auto i = 0; i + 1 < body.length(); i += 2) {
+            auto value = 0;
+            std::from_chars(&body[i], &body[i + 2], value, 16);
+            definition.content += static_cast<char>(value);
+        }
+    } else {
+        definition.content = body;
+    }
+    return definition;
+}
+
+uint64_t peephole::bytes_dropped() const
+{
+    return _bytes_dropped;
+}
+
+void peephole::_process(token& token, std::string& output)
+{
+    if (token.emitted > 0) {
+        if (_held) {
+            _emit(*_held, output);
+            _held.reset();
+        }
+        output.append(token.bytes, token.emitted);
+        _apply(token);
+        return;
+    }
+    if (_held) {
+        const auto next = _first_effective(token);
+        if (next && _supersedes(*_held, *next))
+            _bytes_dropped += _held->bytes.length();
+        else
+            _emit(*_held, output);
+        _held.reset();
+    }
+    if (_redundant(token))
+        _bytes_dropped += token.bytes.length();
+    else if (_holdable(token))
+        _held = token;
+    else
+        _emit(token, output);
+}
+
+const peephole::token* peephole::_first_effective(const token& token) const
+{
+    // When a macro is invoked, it's the first sequence in the macro that
+    // determines whether a held sequence is superseded.
+    if (is_csi(token, "*z")) {
+        const auto head = _macro_heads.find(first_param(token, 0));
+        return head != _macro_heads.end() ? &head->second : nullptr;
+    }
+    return &token;
+}
+
+bool peephole::_supersedes(const token& held, const token& next) const
+{
+    if (is_csi(held, "H"))
+        return is_csi(next, "H") || is_csi(next, "r");
+    if (is_csi(held, " P"))
+        return is_csi(next, " P");
+    if (is_csi(held, "r"))
+        return is_csi(next, "r");
+    if (is_csi(held, "m"))
+        return is_csi(next, "m") && is_sgr_reset(next);
+    return false;
+}
+
+bool peephole::_redundant(const token& token) const
+{
+    if (is_csi(token, " P"))
+        return _page == first_param(token, 1);
+    if (is_csi(token, "H"))
+        return _cursor == token.params;
+    if (is_csi(token, "m"))
+        return is_sgr_default(token) && _rendition == "0";
+    return false;
+}
+
+bool peephole::_holdable(const token& token) const
+{
+    return is_csi(token, "H") || is_csi(token, " P") || is_csi(token, "r") || is_csi(token, "m");
+}
+
+void peephole::_emit(const token& token, std::string& output)
+{
+    output += token.bytes;
+    _apply(token);
+}
+
+void peephole::_apply(const token& token, const int depth)
+{
+    switch (token.type) {
+        case kind::text:
+        case kind::control:
+            _cursor.reset();
+            return;
+        case kind::osc:
+            return;
+        case kind::dcs:
+            _define_macro(token.bytes);
+            return;
+        case kind::esc:
+            // SCS designations don't affect anything we're tracking.
+            if (token.final.length() == 2 && token.final[0] >= '(' && token.final[0] <= '/')
+                return;
+            // S7C1T and S8C1T are also harmless.
+            if (token.final == " F" || token.final == " G")
+                return;
+            // Indexing and line attributes can move the cursor.
+            if (token.final == "M" || token.final == "D" || token.final == "E" || token.final == "9" || token.final.starts_with("#")) {
+                _cursor.reset();
+                return;
+            }
+            _invalidate();
+            return;
+        case kind::csi:
+            break;
+    }
+    if (is_csi(token, "H")) {
+        _cursor = token.params;
+    } else if (is_csi(token, " P")) {
+        _page = first_param(token, 1);
+        _cursor.reset();
+    } else if (is_csi(token, "r")) {
+        _cursor.reset();
+    } else if (is_csi(token, "m")) {
+        if (is_sgr_default(token))
+            _rendition = "0";
+        else
+            _rendition.reset();
+    } else if (is_csi(token, "*z")) {
+        const auto macro = _macros.find(first_param(token, 0));
+        if (macro == _macros.end() || depth > 1) {
+            _invalidate();
+            return;
+        }
+        // Each nesting level has its own tokenizer, which is reused so its
+        // buffers don't need to be reallocated on every invocation.
+        auto& tokenizer = _macro_tokenizers[depth];
+        for (const auto ch : macro->second)
+            if (tokenizer.parse(ch))
+                _apply(tokenizer.current(), depth + 1);
+    } else {
+        // Erasing, editing, scrolling, and copying operations, sound effects,
+        // reports, margins, and mode changes don't affect the page or
+        // rendition, but a mode change (like DECOM) can move the cursor.
+        static constexpr auto harmless = {"J", "K", "X", "'~", "'}", " @", "$v", "$x", "$z", ",~", ",|", "$~", "$p", "$u", "n", "c", "s", "h", "l"};
+        for (const auto final : harmless) {
+            if (token.final == final) {
+                _cursor.reset();
+                // When page coupling (DECPCCM) is changed, a following PPA
+                // may be needed to change the visible page, even if it's
+                // the active page, so it can't be considered redundant.
+                if (token.params == "?64")
+                    _page.reset();
+                return;
+            }
+        }
+        _invalidate();
+    }
+}
+
+void peephole::_define_macro(const std::string& bytes)
+{
+    const auto definition = parse_macro(bytes);
+    if (!definition) return;
+    const auto& [id, delete_all, content] = definition.value();
+    if (delete_all) {
+        _macros.clear();
+        _macro_heads.clear();
+    }
+    _macro_heads.erase(id);
+    if (content.empty()) {
+        _macros.erase(id);
+        return;
+    }
+    _macros[id] = content;
+
+    auto tokenizer = peephole::tokenizer{};
+    for (const auto ch : content) {
+        if (tokenizer.parse(ch)) {
+            _macro_heads[id] = tokenizer.current();
+            break;
+        }
+    }
+}
+
+void peephole::_invalidate()
+{
+    _page.reset();
+    _cursor.reset();
+    _rendition.reset();
+}
@@ -0,0 +1,71 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+class peephole {
+public:
+    struct token {
+        enum class kind { text, control, csi, esc, dcs, osc };
+        kind type = kind::text;
+        std::string bytes;
+        std::string params;
+        std::string final;
+        size_t emitted = 0;
+    };
+
+    class tokenizer {
+    public:
+        bool parse(const char ch);
+        bool pending() const;
+        token& current();
+
+    private:
+        enum class state { ground, escape, csi, string, string_escape };
+        bool _complete(const token::kind type);
+
+        state _state = state::ground;
+        token _token;
+    };
+
+    struct macro_definition {
+        int id = 0;
+        bool delete_all = false;
+        std::string content;
+    };
+    static std::optional<macro_definition> parse_macro(const std::string_view bytes);
+
+    std::string optimize(const std::string_view text);
+    void write(const std::string_view text, std::string& output);
+    void flush(std::string& output);
+    uint64_t bytes_dropped() const;
+
+private:
+    void _process(token& token, std::string& output);
+    const token* _first_effective(const token& token) const;
+    bool _supersedes(const token& held, const token& next) const;
+    bool _redundant(const token& token) const;
+    bool _holdable(const token& token) const;
+    void _emit(const token& token, std::string& output);
+    void _apply(const token& token, const int depth = 0);
+    void _define_macro(const std::string& bytes);
+    void _invalidate();
+
+    tokenizer _tokenizer;
+    std::array<tokenizer, 2> _macro_tokenizers;
+    std::optional<token> _held;
+    std::optional<int> _page;
+    std::optional<std::string> _cursor;
+    std::optional<std::string> _rendition;
+    std::map<int, std::string> _macros;
+    std::map<int, token> _macro_heads;
+    uint64_t _bytes_dropped = 0;
+};
@@ -0,0 +1,225 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "profile.h"
+
+#include "capabilities.h"
+#include "macros.h"
+#include "options.h"
+#include "os.h"
+#include "upload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+// The profile records how long the terminal takes to execute each of our
+// macros. We can only measure the time taken from our side of the link, so
+// each macro is invoked a number of times followed by a DSR-CPR round trip,
+// and the time of an empty round trip is subtracted from the total. The
+// results are saved per terminal model, as identified by the DA report,
+// along with the rendering strategies that were chosen, so later runs on
+// that terminal can use them without timing it again.
+
+namespace {
+
+    using profiled_macro = std::pair<std::string, const macro*>;
+
+    std::vector<profiled_macro> profiled_macros(const macro_manager& macros)
+    {
+        auto list = std::vector<profiled_macro>{};
+        const auto add = [&](const std::string& name, const macro& macro) {
+            list.emplace_back(name, &macro);
+        };
+        const auto add_array = [&](const std::string& name, const auto& array, const size_t count) {
+            for (auto i = size_t{0}; i < count; i++)
+                add(name + "[" + std::to_string(i) + "]", array[i]);
+        };
+        // The page flipping variants are only created when they're in use.
+        const auto pages = static_cast<size_t>(macros.compose_pages());
+        add("scroll_start", macros.scroll_start);
+        add_array("scroll_end", macros.scroll_end, pages);
+        add("scroll_start_with_clouds", macros.scroll_start_with_clouds);
+        add_array("scroll_end_with_clouds", macros.scroll_end_with_clouds, pages);
+        add_array("frame_complete", macros.frame_complete, pages);
+        add_array("trex_running", macros.trex_running, macros.trex_running.size());
+        add_array("trex_jumping", macros.trex_jumping, macros.trex_jumping.size());
+        add_array("trex_dead", macros.trex_dead, macros.trex_dead.size());
+        add("trex_standing", macros.trex_standing);
+        add("game_over_banner", macros.game_over_banner);
+        add("high_score_label", macros.high_score_label);
+        add("double_width", macros.double_width);
+        add_array("cloud_parts", macros.cloud_parts, macros.cloud_parts.size());
+        add_array("cactus_parts", macros.cactus_parts, macros.cactus_parts.size());
+        // The sound effects aren't profiled, since DECPS blocks the terminal
+        // for the duration of the notes, which we already know.
+        return list;
+    }
+
+    // The file starts with a header line, followed by a section for each
+    // terminal that has been profiled. This calls the visitor with the id
+    // of the section and the content of each line in it.
+    template <typename Visitor>
+    bool read_profile(const std::string& filename, const Visitor& visit)
+    {
+        auto file = std::ifstream{filename};
+        auto line = std::string{};
+        if (!std::getline(file, line) || line != "vtrex-profile 1")
+            return false;
+        auto id = std::string{};
+        while (std::getline(file, line)) {
+            auto fields = std::istringstream{line};
+            auto keyword = std::string{};
+            if (!(fields >> keyword)) continue;
+            if (keyword == "terminal")
+                fields >> id;
+            visit(id, line);
+        }
+        return true;
+    }
+
+    void parse_line(profile_entry& entry, const std::string& line)
+    {
+        auto fields = std::istringstream{line};
+        auto keyword = std::string{};
+        fields >> keyword;
+        if (keyword == "round_trip") {
+            fields >> entry.round_trip;
+        } else if (keyword == "upload") {
+            fields >> entry.upload_rate;
+        } else if (keyword == "page_flipping") {
+            auto value = 0;
+            if (fields >> value) entry.page_flipping = value != 0;
+        } else if (keyword == "scroller") {
+            auto name = std::string{};
+            if (fields >> name) entry.scroller = parse_scroll_strategy(name);
+        } else if (keyword == "macro") {
+            auto name = std::string{};
+            auto time = 0.0;
+            if (fields >> name >> time) entry.macro_times[name] = time;
+        }
+    }
+
+}  // namespace
+
+terminal_profile::terminal_profile(const capabilities& caps, const options& options)
+    : _caps{caps}, _options{options}
+{
+    _filename = os::home_path("VTREX_PROFILE", ".vtrex-profile");
+    if (!_filename.empty() && !_load())
+        _other_terminals.clear();
+}
+
+void terminal_profile::measure(macro_manager& macros)
+{
+    // Everything needs to be uploaded first, otherwise we'd be timing the
+    // inline content rather than the macro invocations.
+    macros.upload_pending(std::chrono::steady_clock::time_point::max());
+    // The startup choices aren't taken from the saved profile while we're
+    // profiling, so these are what the terminal has just been timed with.
+    _results.page_flipping = _caps.has_page_flipping;
+    _results.scroller = macros.scroller();
+    // By now the font and all the macros have been uploaded, so that gives
+    // us a reasonable measure of the rate the terminal can accept them.
+    _results.upload_rate = upload::throughput();
+
+    const auto time_batch = [&](const macro* macro) {
+        const auto start = std::chrono::steady_clock::now();
+        for (auto i = 0; macro && i < repeat_count; i++)
+            macro->run(_caps.output());
+        _caps.wait_for_output();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::micro>{elapsed}.count();
+    };
+
+    // The fastest of a few empty round trips is used as the baseline, since
+    // any delays on the link will only ever add to the time.
+    auto& round_trip = _results.round_trip;
+    round_trip = std::numeric_limits<double>::max();
+    for (auto i = 0; i < 4; i++)
+        round_trip = std::min(round_trip, time_batch(nullptr));
+
+    _results.macro_times.clear();
+    for (const auto& [name, macro] : profiled_macros(macros)) {
+        const auto total = time_batch(macro);
+        _results.macro_times[name] = std::max(total - round_trip, 0.0) / repeat_count;
+    }
+}
+
+void terminal_profile::report() const
+{
+    auto& out = _caps.output();
+    const auto& macro_times = _results.macro_times;
+    auto times = std::vector<std::pair<std::string, double>>{macro_times.begin(), macro_times.end()};
+    std::sort(times.begin(), times.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+    out << std::fixed << std::setprecision(1);
+    out << "Terminal:   " << _caps.terminal_id << "\n";
+    out << "Round trip: " << _results.round_trip << " usec\n";
+    out << "Flipping:   " << (_results.page_flipping == true ? "yes" : "no") << "\n";
+    if (_results.scroller)
+        out << "Scrolling:  " << to_string(_results.scroller.value()) << "\n";
+    out << "Upload:     " << _results.upload_rate << " bytes/sec\n";
+    out << "\nMacro                         usec per run\n";
+    for (const auto& [name, time] : times)
+        out << "  " << std::left << std::setw(28) << name << std::right << std::setw(12) << time << "\n";
+    if (!_filename.empty())
+        out << "\nSaved to '" << _filename << "'\n";
+}
+
+void terminal_profile::save() const
+{
+    if (_filename.empty()) return;
+    // The profiles for other terminals are written back unchanged, followed
+    // by the profile for this terminal. If the scroller was chosen on the
+    // command line, rather than by timing, it isn't saved.
+    auto file = std::ofstream{_filename};
+    file << "vtrex-profile 1\n";
+    for (const auto& line : _other_terminals)
+        file << line << "\n";
+    file << "terminal " << _caps.terminal_id << "\n";
+    file << "round_trip " << _results.round_trip << "\n";
+    file << "upload " << _results.upload_rate << "\n";
+    if (_results.page_flipping)
+        file << "page_flipping " << _results.page_flipping.value() << "\n";
+    if (_results.scroller && !_options.scroller)
+        file << "scroller " << to_string(_results.scroller.value()) << "\n";
+    for (const auto& [name, time] : _results.macro_times)
+        file << "macro " << name << " " << time << "\n";
+}
+
+const profile_entry* terminal_profile::cached(const std::string& terminal_id)
+{
+    // The file is read once, the first time it's needed, rather than by
+    // every session, since a server would otherwise be reading it again for
+    // each connection.
+    static const auto entries = [] {
+        auto entries = std::map<std::string, profile_entry>{};
+        const auto filename = os::home_path("VTREX_PROFILE", ".vtrex-profile");
+        if (!filename.empty()) {
+            read_profile(filename, [&](const std::string& id, const std::string& line) {
+                parse_line(entries[id], line);
+            });
+        }
+        return entries;
+    }();
+    const auto entry = entries.find(terminal_id);
+    return entry != entries.end() && !terminal_id.empty() ? &entry->second : nullptr;
+}
+
+bool terminal_profile::_load()
+{
+    // The section for this terminal is about to be measured again, so we
+    // only need to keep the others.
+    return read_profile(_filename, [&](const std::string& id, const std::string& line) {
+        if (id != _caps.terminal_id)
+            _other_terminals.push_back(line);
+    });
+}
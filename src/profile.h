@@ -0,0 +1,45 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include "options.h"
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+class capabilities;
+class macro_manager;
+
+// The results saved for a terminal. The startup choices use these in place
+// of timing the terminal again, when they're available.
+struct profile_entry {
+    double round_trip = 0;
+    double upload_rate = 0;
+    std::optional<bool> page_flipping;
+    std::optional<scroll_strategy> scroller;
+    std::map<std::string, double> macro_times;
+};
+
+class terminal_profile {
+public:
+    terminal_profile(const capabilities& caps, const options& options);
+    void measure(macro_manager& macros);
+    void report() const;
+    void save() const;
+    static const profile_entry* cached(const std::string& terminal_id);
+
+    static constexpr auto repeat_count = 32;
+
+private:
+    bool _load();
+
+    const capabilities& _caps;
+    const options& _options;
+    std::string _filename;
+    profile_entry _results;
+    std::vector<std::string> _other_terminals;
+};
@@ -0,0 +1,101 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "replay.h"
+
+#include "options.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+replay::replay(const options& options)
+    : _record_filename{options.record}
+{
+    if (!options.replay.empty())
+        _playing = _load(options.replay);
+    if (!_playing)
+        _seed = options.seed.value_or(std::random_device{}());
+}
+
+replay::~replay()
+{
+    if (!_playing && !_record_filename.empty())
+        _save(_record_filename);
+}
+
+unsigned replay::seed() const
+{
+    return _seed;
+}
+
+bool replay::playing() const
+{
+    return _playing;
+}
+
+bool replay::next_game()
+{
+    _game_index++;
+    if (_playing)
+        return _game_index < _games.size();
+    // The jumps are only tracked when we're recording, so there's no need
+    // to add a game (and allocate memory for it) otherwise.
+    if (!_record_filename.empty())
+        _games.emplace_back();
+    return true;
+}
+
+bool replay::jump_at(const int frame) const
+{
+    if (!_playing) return false;
+    const auto& jumps = _games[_game_index];
+    return std::binary_search(jumps.begin(), jumps.end(), frame);
+}
+
+void replay::record_jump(const int frame)
+{
+    if (!_playing && !_record_filename.empty())
+        _games[_game_index].push_back(frame);
+}
+
+bool replay::_load(const std::string& filename)
+{
+    // The file starts with a header line and the random seed, followed by
+    // one line per game listing the frames on which a jump was started.
+    // Version 1 files were recorded with a different landscape generator,
+    // so their jumps wouldn't line up with the landscape any more.
+    auto file = std::ifstream{filename};
+    auto line = std::string{};
+    if (!std::getline(file, line) || line != "vtrex-replay 2")
+        return false;
+    auto keyword = std::string{};
+    if (!(file >> keyword >> _seed) || keyword != "seed")
+        return false;
+    while (std::getline(file, line)) {
+        auto fields = std::istringstream{line};
+        if (fields >> keyword && keyword == "game") {
+            auto& jumps = _games.emplace_back();
+            auto frame = 0;
+            while (fields >> frame)
+                jumps.push_back(frame);
+            std::sort(jumps.begin(), jumps.end());
+        }
+    }
+    return !_games.empty();
+}
+
+void replay::_save(const std::string& filename) const
+{
+    auto file = std::ofstream{filename};
+    file << "vtrex-replay 2\n";
+    file << "seed " << _seed << "\n";
+    for (const auto& jumps : _games) {
+        file << "game";
+        for (const auto frame : jumps)
+            file << " " << frame;
+        file << "\n";
+    }
+}
@@ -0,0 +1,31 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class options;
+
+class replay {
+public:
+    replay(const options& options);
+    ~replay();
+    unsigned seed() const;
+    bool playing() const;
+    bool next_game();
+    bool jump_at(const int frame) const;
+    void record_jump(const int frame);
+
+private:
+    bool _load(const std::string& filename);
+    void _save(const std::string& filename) const;
+
+    std::string _record_filename;
+    bool _playing = false;
+    unsigned _seed = 0;
+    std::vector<std::vector<int>> _games;
+    int _game_index = -1;
+};
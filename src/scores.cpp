@@ -0,0 +1,125 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "scores.h"
+
+#include "options.h"
+#include "os.h"
+
+#include <string>
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+namespace {
+
+    void* map_file(const std::string& filename, const size_t length)
+    {
+        const auto file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return nullptr;
+        // The mapping extends the file to the required length if necessary,
+        // and any new content is zero filled, which is an empty table.
+        const auto mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(length), NULL);
+        CloseHandle(file);
+        if (!mapping) return nullptr;
+        const auto view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, length);
+        CloseHandle(mapping);
+        return view;
+    }
+
+    void unmap_file(void* view, const size_t)
+    {
+        UnmapViewOfFile(view);
+    }
+
+}  // namespace
+
+#endif
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    void* map_file(const std::string& filename, const size_t length)
+    {
+        const auto fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return nullptr;
+        // If the file is new (or shorter than expected), it's extended to the
+        // required length, and the new content is zero filled, which is an
+        // empty table. We never shrink it, in case another instance is using
+        // a newer layout.
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) < 0 || (file_stat.st_size < length && ftruncate(fd, length) < 0)) {
+            close(fd);
+            return nullptr;
+        }
+        const auto view = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        return view != MAP_FAILED ? view : nullptr;
+    }
+
+    void unmap_file(void* view, const size_t length)
+    {
+        munmap(view, length);
+    }
+
+}  // namespace
+
+#endif
+
+score_table::score_table(const options& options)
+{
+    // Replays don't count towards the high scores, so they just get a local
+    // table, and we also fall back to that if the file can't be mapped.
+    const auto filename = os::home_path("VTREX_SCORES", ".vtrex-scores");
+    if (options.replay.empty() && !filename.empty())
+        _table = static_cast<table*>(map_file(filename, sizeof(table)));
+    if (!_table)
+        _table = &_local_table;
+}
+
+score_table::~score_table()
+{
+    if (_table != &_local_table)
+        unmap_file(_table, sizeof(table));
+}
+
+int score_table::best() const
+{
+    return _table->scores[0].load(std::memory_order_relaxed);
+}
+
+std::array<int, score_table::size> score_table::top() const
+{
+    auto scores = std::array<int, size>{};
+    for (auto i = 0; i < size; i++)
+        scores[i] = _table->scores[i].load(std::memory_order_relaxed);
+    return scores;
+}
+
+void score_table::submit(const int score)
+{
+    // The new score is inserted by working down the table, swapping it into
+    // the first slot with a lower score, and then carrying on down with the
+    // score it displaced. Each slot only ever increases, so a concurrent
+    // update from another instance can't lose a higher score, and nothing
+    // here will ever block.
+    auto value = static_cast<uint32_t>(score);
+    for (auto& slot : _table->scores) {
+        auto current = slot.load(std::memory_order_relaxed);
+        while (value > current) {
+            if (slot.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+                value = current;
+                break;
+            }
+        }
+        if (value == 0) break;
+    }
+}
@@ -0,0 +1,36 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+class options;
+
+class score_table {
+public:
+    static constexpr int size = 10;
+
+    score_table(const options& options);
+    score_table(const score_table&) = delete;
+    score_table& operator=(const score_table&) = delete;
+    ~score_table();
+    int best() const;
+    std::array<int, size> top() const;
+    void submit(const int score);
+
+private:
+    // This is the layout of the score file, which is mapped into memory and
+    // shared between all running instances, so it can only be updated with
+    // lock-free atomic operations.
+    struct table {
+        std::array<std::atomic<uint32_t>, size> scores;
+    };
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    table* _table = nullptr;
+    table _local_table = {};
+};
@@ -0,0 +1,240 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// These functions build escape sequences in a fixed-size buffer, without any
+// heap allocation or format strings. They're constexpr, so sequences with
+// constant parameters are produced at compile time, and a malformed sequence
+// in a constant expression will fail to compile. At runtime a malformed
+// sequence is caught by an assert, since nothing on the frame path should
+// be throwing exceptions.
+
+namespace vt {
+
+    // This is deliberately not constexpr, so calling it during constant
+    // evaluation is a compile error that names the problem.
+    inline void malformed_sequence(const char*) {}
+
+    constexpr void check_sequence(const bool valid, const char* problem)
+    {
+        if (std::is_constant_evaluated()) {
+            if (!valid) malformed_sequence(problem);
+        } else {
+            assert(valid && problem);
+        }
+    }
+
+    class sequence {
+    public:
+        static constexpr auto capacity = 48;
+
+        constexpr sequence(const std::string_view introducer, const std::initializer_list<int> params, const std::string_view final)
+        {
+            _append(introducer);
+            auto separator = false;
+            for (const auto param : params) {
+                check_sequence(param >= 0, "negative parameter");
+                if (separator) _append(';');
+                _append(param < 0 ? 0 : param);
+                separator = true;
+            }
+            // The final string may contain intermediates, but it must end with
+            // a single final character. Control sequence finals are in the
+            // range 0x40 to 0x7E, but escape sequences can also use 0x30 up.
+            const auto min_final = introducer == "\033" ? 0x30 : 0x40;
+            check_sequence(!final.empty(), "missing final");
+            for (auto i = size_t{1}; i < final.length(); i++)
+                check_sequence(final[i - 1] >= 0x20 && final[i - 1] <= 0x2F, "invalid intermediate");
+            check_sequence(!final.empty() && final.back() >= min_final && final.back() <= 0x7E, "invalid final");
+            _append(final);
+        }
+
+        constexpr operator std::string_view() const
+        {
+            return {_chars.data(), _length};
+        }
+
+    private:
+        constexpr void _append(const char ch)
+        {
+            check_sequence(_length < capacity, "sequence too long");
+            if (_length < capacity) _chars[_length++] = ch;
+        }
+
+        constexpr void _append(const std::string_view text)
+        {
+            for (const auto ch : text) _append(ch);
+        }
+
+        constexpr void _append(const int value)
+        {
+            if (value >= 10) _append(value / 10);
+            _append(static_cast<char>('0' + value % 10));
+        }
+
+        std::array<char, capacity> _chars = {};
+        size_t _length = 0;
+    };
+
+    inline std::ostream& operator<<(std::ostream& stream, const sequence& sequence)
+    {
+        return stream << std::string_view{sequence};
+    }
+
+    constexpr auto csi(const std::initializer_list<int> params, const std::string_view final)
+    {
+        return sequence{"\033[", params, final};
+    }
+
+    constexpr auto esc(const std::string_view final)
+    {
+        return sequence{"\033", {}, final};
+    }
+
+    // DECSET - Set DEC Private Mode
+    constexpr auto decset(const int mode)
+    {
+        return sequence{"\033[?", {mode}, "h"};
+    }
+
+    // DECRST - Reset DEC Private Mode
+    constexpr auto decrst(const int mode)
+    {
+        return sequence{"\033[?", {mode}, "l"};
+    }
+
+    // CUP - Cursor Position
+    constexpr auto cup(const int row)
+    {
+        return csi({row}, "H");
+    }
+
+    constexpr auto cup(const int row, const int column)
+    {
+        return csi({row, column}, "H");
+    }
+
+    // CUF - Cursor Forward
+    constexpr auto cuf()
+    {
+        return csi({}, "C");
+    }
+
+    // RI - Reverse Index
+    constexpr auto ri()
+    {
+        return esc("M");
+    }
+
+    // DECDWL - Double-Width Line
+    constexpr auto decdwl()
+    {
+        return esc("#6");
+    }
+
+    // DECSTBM - Set Top and Bottom Margins
+    constexpr auto decstbm()
+    {
+        return csi({}, "r");
+    }
+
+    constexpr auto decstbm(const int top, const int bottom)
+    {
+        return csi({top, bottom}, "r");
+    }
+
+    // DECDC - Delete Column
+    constexpr auto decdc()
+    {
+        return csi({}, "'~");
+    }
+
+    constexpr auto decdc(const int count)
+    {
+        return csi({count}, "'~");
+    }
+
+    // SL - Scroll Left
+    constexpr auto sl()
+    {
+        return csi({}, " @");
+    }
+
+    // DECFI - Forward Index
+    constexpr auto decfi()
+    {
+        return esc("9");
+    }
+
+    // DECSLRM - Set Left and Right Margins
+    constexpr auto decslrm()
+    {
+        return csi({}, "s");
+    }
+
+    constexpr auto decslrm(const int left, const int right)
+    {
+        return csi({left, right}, "s");
+    }
+
+    // PPA - Page Position Absolute
+    constexpr auto ppa(const int page)
+    {
+        return csi({page}, " P");
+    }
+
+    // DECCRA - Copy Rectangular Area
+    constexpr auto deccra(const int top, const int left, const int bottom, const int right, const int page, const int dst_top, const int dst_left, const int dst_page)
+    {
+        return csi({top, left, bottom, right, page, dst_top, dst_left, dst_page}, "$v");
+    }
+
+    // SGR - Select Graphic Rendition
+    constexpr auto sgr()
+    {
+        return csi({}, "m");
+    }
+
+    constexpr auto sgr(const int attribute)
+    {
+        return csi({attribute}, "m");
+    }
+
+    // DECINVM - Invoke Macro
+    constexpr auto decinvm(const int id)
+    {
+        return csi({id}, "*z");
+    }
+
+    // DECPS - Play Sound
+    constexpr auto decps(const int volume, const int duration, const int note)
+    {
+        return csi({volume, duration, note}, ",~");
+    }
+
+    // Converts any 7-bit C1 controls (ESC followed by a character from 0x40
+    // to 0x5F) into their single byte 8-bit equivalents.
+    inline std::string to_8bit(const std::string_view text)
+    {
+        auto converted = std::string{};
+        converted.reserve(text.length());
+        for (auto i = 0; i < text.length(); i++) {
+            if (text[i] == '\033' && i + 1 < text.length() && text[i + 1] >= 0x40 && text[i + 1] <= 0x5F)
+                converted += static_cast<char>(text[++i] + 0x40);
+            else
+                converted += text[i];
+        }
+        return converted;
+    }
+
+}  // namespace vt
@@ -0,0 +1,193 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "server.h"
+
+#include "options.h"
+#include "os.h"
+#include "scores.h"
+#include "session.h"
+
+#include <iostream>
+
+server::server(const options& options, score_table& scores, const os& console)
+    : _options{options}, _scores{scores}, _console{console}
+{
+}
+
+#ifdef __linux__
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <streambuf>
+
+namespace {
+
+    // Session output is buffered and written straight to the socket. We use
+    // MSG_NOSIGNAL so a client disconnecting can't raise a SIGPIPE, and any
+    // output after that point is just discarded.
+    class socket_output : public std::streambuf {
+    public:
+        socket_output(const int fd)
+            : _fd{fd}
+        {
+            setp(_buffer.data(), _buffer.data() + _buffer.size());
+        }
+
+    private:
+        int_type overflow(int_type ch) override
+        {
+            sync();
+            if (!traits_type::eq_int_type(ch, traits_type::eof()))
+                sputc(traits_type::to_char_type(ch));
+            return traits_type::not_eof(ch);
+        }
+
+        int sync() override
+        {
+            auto data = pbase();
+            auto length = pptr() - pbase();
+            while (length > 0 && _connected) {
+                const auto written = send(_fd, data, length, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) _connected = false;
+                data += written;
+                length -= written;
+            }
+            setp(_buffer.data(), _buffer.data() + _buffer.size());
+            return 0;
+        }
+
+        int _fd;
+        bool _connected = true;
+        std::array<char, 4096> _buffer;
+    };
+
+}  // namespace
+
+bool server::run()
+{
+    const auto& path = _options.serve;
+    auto address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (path.length() >= sizeof(address.sun_path)) {
+        std::cout << "VT-Rex: socket path '" << path << "' is too long\n";
+        return false;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    // A socket left behind by an earlier server would stop us binding, so
+    // that's removed first.
+    unlink(path.c_str());
+    const auto listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    const auto bound = listen_fd >= 0 && bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    if (!bound || listen(listen_fd, SOMAXCONN) != 0) {
+        std::cout << "VT-Rex: unable to listen on '" << path << "': " << std::strerror(errno) << "\n";
+        if (listen_fd >= 0) close(listen_fd);
+        return false;
+    }
+
+    std::cout << "VT-Rex: serving on '" << path << "', press Q to stop\n";
+    std::cout.flush();
+    auto accept_thread = std::thread{&server::_accept_connections, this, listen_fd};
+
+    // The server runs until Q or Ctrl+C is pressed on the console. If the
+    // console input has been closed, it carries on until it's killed.
+    for (;;) {
+        const auto ch = _console.getch();
+        if (ch == 'q' || ch == 'Q' || ch == 3) break;
+        if (ch < 0) {
+            accept_thread.join();
+            break;
+        }
+    }
+
+    // Shutting down the listening socket wakes up the accept loop, and then
+    // shutting down the connections ends any sessions still in progress,
+    // since their keyboard input will be closed.
+    shutdown(listen_fd, SHUT_RDWR);
+    if (accept_thread.joinable())
+        accept_thread.join();
+    close(listen_fd);
+    unlink(path.c_str());
+    _close_connections();
+    for (auto& thread : _threads)
+        thread.join();
+
+    std::cout << "Sessions served: " << _sessions_served << "\n";
+    return true;
+}
+
+void server::_accept_connections(const int listen_fd)
+{
+    for (;;) {
+        const auto fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+        const auto lock = std::lock_guard{_mutex};
+        _join_finished_sessions();
+        _open_connections.insert(fd);
+        _threads.emplace_back(&server::_serve_connection, this, fd);
+        _sessions_served++;
+    }
+}
+
+void server::_serve_connection(const int fd)
+{
+    {
+        const auto connection_os = os{fd, fd};
+        auto connection_output = socket_output{fd};
+        auto out = std::ostream{&connection_output};
+        auto connection = session{_options, _scores, connection_os, out};
+        connection.run();
+        out.flush();
+    }
+    const auto lock = std::lock_guard{_mutex};
+    _open_connections.erase(fd);
+    _finished_threads.push_back(std::this_thread::get_id());
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+}
+
+void server::_join_finished_sessions()
+{
+    // This is called with the mutex held, on each new connection, so the
+    // threads of sessions that have ended don't accumulate for the life of
+    // the server. A finished thread has nothing left to do but return, so
+    // the join won't block for long.
+    for (const auto id : _finished_threads) {
+        const auto match = [=](const auto& thread) { return thread.get_id() == id; };
+        const auto thread = std::find_if(_threads.begin(), _threads.end(), match);
+        if (thread != _threads.end()) {
+            thread->join();
+            _threads.erase(thread);
+        }
+    }
+    _finished_threads.clear();
+}
+
+void server::_close_connections()
+{
+    const auto lock = std::lock_guard{_mutex};
+    for (const auto fd : _open_connections)
+        shutdown(fd, SHUT_RDWR);
+}
+
+#else
+
+bool server::run()
+{
+    std::cout << "VT-Rex: option '--serve' is not supported on this platform\n";
+    return false;
+}
+
+#endif
@@ -0,0 +1,39 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+class options;
+class os;
+class score_table;
+
+// The server listens on a Unix domain socket, and runs a separate session
+// for every connection, so a single process can drive any number of
+// terminals. The score table is shared between them all.
+
+class server {
+public:
+    server(const options& options, score_table& scores, const os& console);
+    bool run();
+
+private:
+    void _accept_connections(const int listen_fd);
+    void _serve_connection(const int fd);
+    void _close_connections();
+    void _join_finished_sessions();
+
+    const options& _options;
+    score_table& _scores;
+    const os& _console;
+    std::mutex _mutex;
+    std::vector<std::thread> _threads;
+    std::vector<std::thread::id> _finished_threads;
+    std::set<int> _open_connections;
+    int _sessions_served = 0;
+};
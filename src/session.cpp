@@ -0,0 +1,184 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "session.h"
+
+#include "allocations.h"
+#include "capabilities.h"
+#include "coloring.h"
+#include "font.h"
+#include "keyboard.h"
+#include "macros.h"
+#include "options.h"
+#include "os.h"
+#include "profile.h"
+#include "scores.h"
+#include "streams.h"
+
+#include <optional>
+
+session::session(const options& options, score_table& scores, const os& os, std::ostream& out)
+    : _options{options}, _scores{scores}, _os{os}, _out{out}, _replay{options}
+{
+}
+
+bool session::run()
+{
+    if (!_options.replay.empty() && !_replay.playing()) {
+        _out << "VT-Rex: unable to load replay '" << _options.replay << "'\n";
+        return false;
+    }
+
+    // In headless mode there's no terminal, so the output is discarded.
+    null_output null_output(_out, _options.headless);
+    // Redundant sequences are removed from the output as it's written.
+    peephole_output peephole_output(_out);
+
+    const auto caps = capabilities{_options, _os, _out};
+    if (!_check_compatibility(caps))
+        return false;
+
+    // If the terminal accepted 8-bit controls, we use them for everything.
+    c1_output c1_output(_out, caps.has_8bit_controls);
+
+    // Set the window title.
+    _out << "\033]21;VT-Rex\033\\";
+    // Load the soft font.
+    const auto font = soft_font{caps};
+    // Initialize the macros.
+    auto macros = macro_manager{caps, _options};
+    // Setup the color assignment and palette.
+    const auto colors = coloring{caps, _options};
+    // Save the modes and settings that we're going to change.
+    const auto original_decscnm = caps.query_mode(5);
+    const auto original_decawm = caps.query_mode(7);
+    const auto original_decssdt = caps.query_setting("$~");
+    // Reverse screen attributes so it's effectively black on white.
+    _out << "\033[?5h";
+    // Disable line wrapping.
+    _out << "\033[?7l";
+    // Disable page cursor coupling.
+    _out << "\033[?64l";
+    // Hide the status line.
+    _out << "\033[0$~";
+    // Clear margins.
+    _out << "\033[r";
+    // Set default attributes.
+    _out << "\033[m";
+    // Clear the screen.
+    _out << "\033[2J";
+    // Hide the cursor.
+    _out << "\033[?25l";
+    // Make the play area double width
+    macros.double_width.run(_out);
+
+    _out.flush();
+    _startup_bytes = null_output.bytes_written();
+
+    // When profiling, we time the macros in place of playing a game. Otherwise
+    // the engine is chosen to match the playfield width that fits the screen.
+    // The profile is only loaded when it's needed, since every connection
+    // to a server would otherwise be reading the file for nothing.
+    auto profile = std::optional<terminal_profile>{};
+    if (_options.profile) {
+        profile.emplace(caps, _options);
+        profile->measure(macros);
+        profile->save();
+    } else if (macros.playfield_width() == engine_base::wide_width) {
+        _play_games<engine_base::wide_width>(macros);
+    } else {
+        _play_games<engine_base::narrow_width>(macros);
+    }
+
+    _out.flush();
+    ALLOCATION_PHASE("shutdown");
+    _frame_bytes = null_output.bytes_written() - _startup_bytes;
+
+    // Clear the window title.
+    _out << "\033]21;\033\\";
+    // Set default attributes.
+    _out << "\033[m";
+    // Clear all pages.
+    if (caps.has_page_flipping)
+        _out << "\033[4 P\033[2J";
+    _out << "\033[3 P\033[2J";
+    _out << "\033[2 P\033[2J";
+    _out << "\033[1 P\033[H\033[J";
+    // Make sure page 1 is visible.
+    _out << "\033[?64h";
+    // Reset reverse screen attributes if not originally set.
+    if (original_decscnm != true)
+        _out << "\033[?5l";
+    // Reapply line wrapping if not originally reset.
+    if (original_decawm != false)
+        _out << "\033[?7h";
+    // Restore the original status display type.
+    if (!original_decssdt.empty())
+        _out << "\033[" << original_decssdt;
+    // Show the cursor.
+    _out << "\033[?25h";
+
+    if (profile)
+        profile->report();
+
+    _bytes_dropped = peephole_output.bytes_dropped();
+    return true;
+}
+
+int session::frames_rendered() const
+{
+    return _frames_rendered;
+}
+
+uint64_t session::startup_bytes() const
+{
+    return _startup_bytes;
+}
+
+uint64_t session::frame_bytes() const
+{
+    return _frame_bytes;
+}
+
+uint64_t session::bytes_dropped() const
+{
+    return _bytes_dropped;
+}
+
+bool session::_check_compatibility(const capabilities& caps) const
+{
+    const auto compatible =
+        caps.has_soft_fonts &&
+        caps.has_horizontal_scrolling &&
+        caps.has_rectangle_ops &&
+        caps.has_pages;
+    if (!compatible && !_options.yolo) {
+        _out << "VT-Rex requires a VT420-compatible terminal or better.\n";
+        _out << "Try 'vtrex --yolo' to bypass the compatibility checks.\n";
+        return false;
+    }
+    if (caps.height < engine_base::height) {
+        _out << "VT-Rex requires a minimum screen height of " << engine_base::height << ".\n";
+        return false;
+    }
+    if (caps.width < engine_base::narrow_width * 2) {
+        _out << "VT-Rex requires a minimum screen width of " << engine_base::narrow_width * 2 << ".\n";
+        return false;
+    }
+    return true;
+}
+
+template <int _Width>
+void session::_play_games(macro_manager& macros)
+{
+    // The keyboard is only read once we're done querying the terminal.
+    auto game_keyboard = keyboard{_options, _os};
+    for (auto game = 0; _replay.next_game(); game++) {
+        const auto generator = engine_base::generator{_replay.seed(), game};
+        auto game_engine = engine<_Width>{macros, _options, _replay, _scores, game_keyboard, generator};
+        const auto completed = game_engine.run();
+        _frames_rendered += game_engine.frames_rendered();
+        if (!completed) break;
+    }
+}
@@ -0,0 +1,46 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include "engine.h"
+#include "replay.h"
+
+#include <cstdint>
+#include <ostream>
+
+class capabilities;
+class macro_manager;
+class options;
+class os;
+class score_table;
+
+// A session is everything that happens on one terminal, from the capability
+// queries through to the cleanup on exit. All of its state is held here, or
+// in the objects it creates, so any number of sessions can be run at once.
+
+class session {
+public:
+    session(const options& options, score_table& scores, const os& os, std::ostream& out);
+    bool run();
+    int frames_rendered() const;
+    uint64_t startup_bytes() const;
+    uint64_t frame_bytes() const;
+    uint64_t bytes_dropped() const;
+
+private:
+    bool _check_compatibility(const capabilities& caps) const;
+    template <int _Width>
+    void _play_games(macro_manager& macros);
+
+    const options& _options;
+    score_table& _scores;
+    const os& _os;
+    std::ostream& _out;
+    replay _replay;
+    int _frames_rendered = 0;
+    uint64_t _startup_bytes = 0;
+    uint64_t _frame_bytes = 0;
+    uint64_t _bytes_dropped = 0;
+};
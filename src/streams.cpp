@@ -0,0 +1,143 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "streams.h"
+
+null_output::null_output(std::ostream& stream, const bool enabled)
+    : _stream{stream}, _enabled{enabled}
+{
+    // When enabled, everything written to the stream is counted and discarded.
+    if (_enabled)
+        _original = _stream.rdbuf(this);
+}
+
+null_output::~null_output()
+{
+    if (_enabled)
+        _stream.rdbuf(_original);
+}
+
+uint64_t null_output::bytes_written() const
+{
+    return _bytes_written;
+}
+
+null_output::int_type null_output::overflow(int_type ch)
+{
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        _bytes_written++;
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize null_output::xsputn(const char_type* s, std::streamsize count)
+{
+    _bytes_written += count;
+    return count;
+}
+
+peephole_output::peephole_output(std::ostream& stream)
+    : _stream{stream}
+{
+    // Everything written to the stream is passed through the peephole optimizer.
+    _original = _stream.rdbuf(this);
+}
+
+peephole_output::~peephole_output()
+{
+    sync();
+    _stream.rdbuf(_original);
+}
+
+uint64_t peephole_output::bytes_dropped() const
+{
+    return _peephole.bytes_dropped();
+}
+
+peephole_output::int_type peephole_output::overflow(int_type ch)
+{
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        const auto c = traits_type::to_char_type(ch);
+        xsputn(&c, 1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize peephole_output::xsputn(const char_type* s, std::streamsize count)
+{
+    _peephole.write({s, static_cast<size_t>(count)}, _buffer);
+    _original->sputn(_buffer.data(), _buffer.size());
+    _buffer.clear();
+    return count;
+}
+
+int peephole_output::sync()
+{
+    _peephole.flush(_buffer);
+    _original->sputn(_buffer.data(), _buffer.size());
+    _buffer.clear();
+    return _original->pubsync();
+}
+
+c1_output::c1_output(std::ostream& stream, const bool enabled)
+    : _stream{stream}
+{
+    // When enabled, the 7-bit C1 controls written to the stream are converted
+    // to their 8-bit form, so ESC [ becomes CSI, ESC P becomes DCS, etc.
+    if (enabled)
+        _original = _stream.rdbuf(this);
+}
+
+c1_output::~c1_output()
+{
+    if (_original) {
+        sync();
+        _stream.rdbuf(_original);
+    }
+}
+
+c1_output::int_type c1_output::overflow(int_type ch)
+{
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        const auto c = traits_type::to_char_type(ch);
+        xsputn(&c, 1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize c1_output::xsputn(const char_type* s, std::streamsize count)
+{
+    auto start = s;
+    const auto end = s + count;
+    for (auto p = s; p < end; p++) {
+        if (_pending_escape) {
+            _pending_escape = false;
+            if (*p >= 0x40 && *p <= 0x5F) {
+                _original->sputc(static_cast<char>(*p + 0x40));
+                start = p + 1;
+                continue;
+            }
+            _original->sputc('\033');
+            start = p;
+        }
+        if (*p == '\033') {
+            // The character following the escape determines whether it can
+            // be converted, so we hold it back until that comes through.
+            _original->sputn(start, p - start);
+            _pending_escape = true;
+            start = p + 1;
+        }
+    }
+    if (!_pending_escape)
+        _original->sputn(start, end - start);
+    return count;
+}
+
+int c1_output::sync()
+{
+    if (_pending_escape) {
+        _original->sputc('\033');
+        _pending_escape = false;
+    }
+    return _original->pubsync();
+}
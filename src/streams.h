@@ -0,0 +1,60 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include "peephole.h"
+
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+class null_output : private std::streambuf {
+public:
+    null_output(std::ostream& stream, const bool enabled);
+    ~null_output();
+    uint64_t bytes_written() const;
+
+private:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+
+    std::ostream& _stream;
+    std::streambuf* _original = nullptr;
+    bool _enabled;
+    uint64_t _bytes_written = 0;
+};
+
+class peephole_output : private std::streambuf {
+public:
+    peephole_output(std::ostream& stream);
+    ~peephole_output();
+    uint64_t bytes_dropped() const;
+
+private:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+    int sync() override;
+
+    std::ostream& _stream;
+    std::streambuf* _original = nullptr;
+    peephole _peephole;
+    std::string _buffer;
+};
+
+class c1_output : private std::streambuf {
+public:
+    c1_output(std::ostream& stream, const bool enabled);
+    ~c1_output();
+
+private:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+    int sync() override;
+
+    std::ostream& _stream;
+    std::streambuf* _original = nullptr;
+    bool _pending_escape = false;
+};
@@ -0,0 +1,141 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "trace.h"
+
+#ifdef VTREX_TRACING
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+    struct event {
+        const char* name;
+        steady_clock::time_point start;
+        steady_clock::time_point end;
+        bool is_counter = false;
+        double value = 0;
+    };
+
+    // Each thread records into its own fixed-size buffer, so there's no
+    // locking required on the hot path. The buffers are pushed onto a global
+    // list the first time a thread records something, and they're never
+    // freed, so they can still be written out after their threads have gone.
+    struct buffer {
+        static constexpr auto capacity = 1 << 16;
+        event events[capacity];
+        std::atomic<int> count = 0;
+        int dropped = 0;
+        int thread_id = 0;
+        buffer* next = nullptr;
+    };
+
+    std::atomic<buffer*> buffers = nullptr;
+    std::atomic<int> thread_count = 0;
+    const auto process_start = steady_clock::now();
+
+    buffer& thread_buffer()
+    {
+        thread_local auto local = [] {
+            const auto b = new buffer{};
+            b->thread_id = ++thread_count;
+            b->next = buffers.load();
+            while (!buffers.compare_exchange_weak(b->next, b));
+            return b;
+        }();
+        return *local;
+    }
+
+    auto timestamp(const steady_clock::time_point time)
+    {
+        return duration_cast<microseconds>(time - process_start).count();
+    }
+
+    // The trace file is written out automatically when the program exits.
+    struct exporter {
+        ~exporter() { trace::write(); }
+    } exporter_instance;
+
+    void add_event(const event& event)
+    {
+        auto& buffer = thread_buffer();
+        const auto count = buffer.count.load(std::memory_order_relaxed);
+        if (count < buffer.capacity) {
+            buffer.events[count] = event;
+            buffer.count.store(count + 1, std::memory_order_release);
+        } else {
+            buffer.dropped++;
+        }
+    }
+
+}  // namespace
+
+void trace::record(const char* name, const steady_clock::time_point start)
+{
+    add_event({name, start, steady_clock::now()});
+}
+
+void trace::counter(const char* name, const double value)
+{
+    const auto now = steady_clock::now();
+    add_event({name, now, now, true, value});
+}
+
+void trace::write()
+{
+    static auto written = false;
+    if (written) return;
+    written = true;
+
+    // The output is in the Chrome trace event format, which can be loaded
+    // into chrome://tracing or https://ui.perfetto.dev for viewing.
+    const auto filename = std::getenv("VTREX_TRACE");
+    auto file = std::ofstream{filename ? filename : "vtrex-trace.json"};
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    auto separator = "\n";
+    for (auto b = buffers.load(); b; b = b->next) {
+        const auto count = b->count.load(std::memory_order_acquire);
+        for (auto i = 0; i < count; i++) {
+            const auto& event = b->events[i];
+            file << separator;
+            if (event.is_counter) {
+                file << "{\"name\":\"" << event.name << "\",\"ph\":\"C\"";
+                file << ",\"ts\":" << timestamp(event.start);
+                file << ",\"pid\":1,\"tid\":" << b->thread_id;
+                file << ",\"args\":{\"value\":" << event.value << "}}";
+            } else {
+                file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\"";
+                file << ",\"ts\":" << timestamp(event.start);
+                file << ",\"dur\":" << timestamp(event.end) - timestamp(event.start);
+                file << ",\"pid\":1,\"tid\":" << b->thread_id << "}";
+            }
+            separator = ",\n";
+        }
+        if (b->dropped > 0) {
+            file << separator;
+            file << "{\"name\":\"dropped\",\"ph\":\"C\",\"ts\":" << timestamp(steady_clock::now());
+            file << ",\"pid\":1,\"tid\":" << b->thread_id;
+            file << ",\"args\":{\"events\":" << b->dropped << "}}";
+        }
+    }
+    file << "\n]}\n";
+}
+
+trace::scope::scope(const char* name)
+    : _name{name}, _start{steady_clock::now()}
+{
+}
+
+trace::scope::~scope()
+{
+    record(_name, _start);
+}
+
+#endif
@@ -0,0 +1,43 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+// Trace points are only compiled in when the VTREX_TRACING option is enabled
+// in the build. Otherwise the TRACE_SCOPE macro expands to nothing, so there
+// is no cost to leaving them in the hot paths.
+
+#ifdef VTREX_TRACING
+
+#include <chrono>
+
+class trace {
+public:
+    class scope;
+    static void record(const char* name, const std::chrono::steady_clock::time_point start);
+    static void counter(const char* name, const double value);
+    static void write();
+};
+
+class trace::scope {
+public:
+    scope(const char* name);
+    ~scope();
+
+private:
+    const char* _name;
+    std::chrono::steady_clock::time_point _start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace::scope TRACE_CONCAT(trace_scope_, __LINE__){name}
+#define TRACE_COUNTER(name, value) trace::counter(name, value)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_COUNTER(name, value)
+
+#endif
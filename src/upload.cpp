@@ -0,0 +1,52 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "upload.h"
+
+#include "os.h"
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+using std::chrono::steady_clock;
+
+namespace {
+
+    // These are totals across all sessions, so they're updated atomically.
+    std::atomic<uint64_t> total_bytes = 0;
+    std::atomic<steady_clock::rep> total_ticks = 0;
+
+}  // namespace
+
+void upload::write(std::ostream& out, const os& os, const std::string_view data)
+{
+    TRACE_SCOPE("upload");
+    // Large blocks of output, like the soft font and the macro definitions,
+    // can easily overrun the input buffer of a real terminal. So rather than
+    // writing them out in one go, we send them in small chunks, and wait for
+    // each chunk to be transmitted before moving on to the next. When the
+    // terminal sends XOFF, the tty driver holds back our output until it
+    // sends XON, so that's where we'll be waiting.
+    out.flush();
+    os.drain();
+    const auto start = steady_clock::now();
+    for (auto offset = size_t{0}; offset < data.length(); offset += chunk_size) {
+        out << data.substr(offset, chunk_size);
+        out.flush();
+        os.drain();
+    }
+    total_bytes += data.length();
+    total_ticks += (steady_clock::now() - start).count();
+    TRACE_COUNTER("upload bytes/s", throughput());
+}
+
+double upload::throughput()
+{
+    // This is the average rate in bytes per second across all the uploads.
+    const auto total_time = steady_clock::duration{total_ticks.load()};
+    const auto seconds = std::chrono::duration<double>(total_time).count();
+    return seconds > 0 ? total_bytes / seconds : 0.0;
+}
@@ -0,0 +1,19 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <ostream>
+#include <string_view>
+
+class os;
+
+class upload {
+public:
+    static void write(std::ostream& out, const os& os, const std::string_view data);
+    static double throughput();
+
+private:
+    static constexpr auto chunk_size = 256;
+};
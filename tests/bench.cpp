@@ -0,0 +1,82 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+// These are microbenchmarks for the paths covered by the unit tests. They
+// just report the time per operation, since the timings vary too much from
+// one machine to the next to be used as a pass or fail condition. Pass an
+// iteration count to run them for longer.
+
+#include "capabilities.h"
+#include "engine.h"
+#include "macros.h"
+#include "options.h"
+#include "os.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+    struct exposed : engine_base {
+        template <class _Ty, int _Size>
+        using buffer = engine_base::buffer<_Ty, _Size>;
+    };
+
+    // The result of each operation is accumulated here, so the compiler
+    // can't optimize the work away.
+    volatile size_t sink = 0;
+
+    template <typename Operation>
+    void measure(const char* name, const int iterations, const Operation& operation)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (auto i = 0; i < iterations; i++)
+            sink = sink + operation(i);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const auto nanoseconds = std::chrono::duration<double, std::nano>{elapsed}.count() / iterations;
+        std::cout << "  " << std::left << std::setw(28) << name << std::right << std::setw(12) << nanoseconds << "\n";
+    }
+
+}  // namespace
+
+int main(const int argc, const char* argv[])
+{
+    const auto iterations = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 10000;
+
+    const char* args[] = {"vtrex", "--headless", "--replay", "unused"};
+    const auto headless = options{4, args};
+    auto out = std::ostringstream{};
+    const auto connection = os{};
+    const auto caps = capabilities{headless, connection, out};
+    auto macros = macro_manager{caps, headless};
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Operation                       nsec per op\n";
+
+    auto sounds = exposed::buffer<int, 4>{};
+    measure("buffer push/pop", iterations * 100, [&](const int i) {
+        sounds.push_back(i);
+        return sounds.pop_front();
+    });
+
+    const auto text = std::string{"\033[1;2H\033[3 P\033[2;10r\033[2'~\033[r\033[1 P"};
+    measure("macro_manager::create", iterations, [&](const int) {
+        return macros.create(text).definition().length();
+    });
+
+    measure("capabilities::csi_report", iterations * 10, [&](const int) {
+        const auto report = capabilities::csi_report("\033[?65;1;2;7;8;9;12;18;19;21;22;23;24;28;29;32;42;44;45c", 'c');
+        return capabilities::numeric_params(report.substr(1)).size();
+    });
+
+    const char* command_line[] = {"vtrex", "--mono", "--speed", "20", "--seed", "42", "--scroll", "sl"};
+    measure("options", iterations, [&](const int) {
+        return static_cast<size_t>(options{8, command_line}.fps);
+    });
+    return 0;
+}
@@ -0,0 +1,33 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#pragma once
+
+#include <iostream>
+
+// This is just enough of a test framework to run offline without any
+// dependencies. A failed check is reported with its location, and the suite
+// carries on, so one run shows every failure. The test runner's exit code is
+// the number of failures.
+
+namespace test {
+
+    inline int failures = 0;
+
+    inline void check(const bool passed, const char* expression, const char* file, const int line)
+    {
+        if (!passed) {
+            std::cout << file << "(" << line << "): check failed: " << expression << "\n";
+            failures++;
+        }
+    }
+
+    void buffer_suite();
+    void macros_suite();
+    void capabilities_suite();
+    void options_suite();
+
+}  // namespace test
+
+#define CHECK(...) test::check((__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
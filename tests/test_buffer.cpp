@@ -0,0 +1,54 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "check.h"
+
+#include "engine.h"
+
+namespace {
+
+    // The buffer is an implementation detail of the engine, so we need a
+    // derived class to get at it.
+    struct exposed : engine_base {
+        template <class _Ty, int _Size>
+        using buffer = engine_base::buffer<_Ty, _Size>;
+    };
+
+    using buffer = exposed::buffer<int, 4>;
+
+}  // namespace
+
+void test::buffer_suite()
+{
+    // A new buffer is empty.
+    auto values = buffer{};
+    CHECK(values.empty());
+
+    // Values come out in the order they went in.
+    CHECK(values.push_back(1));
+    CHECK(values.push_back(2));
+    CHECK(!values.empty());
+    CHECK(values.pop_front() == 1);
+    CHECK(values.pop_front() == 2);
+    CHECK(values.empty());
+
+    // Once full, further values are refused, and what's queued is intact.
+    for (auto i = 10; i < 14; i++)
+        CHECK(values.push_back(i));
+    CHECK(!values.push_back(99));
+    for (auto i = 10; i < 14; i++)
+        CHECK(values.pop_front() == i);
+    CHECK(values.empty());
+
+    // The storage wraps around many times without losing the ordering.
+    auto next_in = 0;
+    auto next_out = 0;
+    for (auto round = 0; round < 100; round++) {
+        for (auto i = 0; i < round % 4 + 1; i++)
+            CHECK(values.push_back(next_in++));
+        while (!values.empty())
+            CHECK(values.pop_front() == next_out++);
+    }
+    CHECK(next_in == next_out);
+}
@@ -0,0 +1,42 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "check.h"
+
+#include "capabilities.h"
+
+#include <vector>
+
+void test::capabilities_suite()
+{
+    // CSI reports can use 7-bit or 8-bit introducers.
+    CHECK(capabilities::csi_report("\033[24;80R", 'R') == "24;80");
+    CHECK(capabilities::csi_report("\x9B" "24;80R", 'R') == "24;80");
+    CHECK(capabilities::csi_report("\033[?64;1;2c", 'c') == "?64;1;2");
+    CHECK(capabilities::csi_report("\033[?69;2$y", 'y') == "?69;2$");
+
+    // Anything that isn't the expected report is rejected.
+    CHECK(capabilities::csi_report("\033[24;80R", 'c').empty());
+    CHECK(capabilities::csi_report("\033P24;80R", 'R').empty());
+    CHECK(capabilities::csi_report("24;80R", 'R').empty());
+    CHECK(capabilities::csi_report("\033[24\033;80R", 'R').empty());
+    CHECK(capabilities::csi_report("", 'R').empty());
+
+    // DCS reports can use either form of introducer and terminator.
+    CHECK(capabilities::dcs_report("\033P1$r0m\033\\") == "1$r0m");
+    CHECK(capabilities::dcs_report("\x90" "1$r0m\x9C") == "1$r0m");
+    CHECK(capabilities::dcs_report("\033P1$r0m\x9C") == "1$r0m");
+    CHECK(capabilities::dcs_report("\033P1$r0m").empty());
+    CHECK(capabilities::dcs_report("\033[1$r0m\033\\").empty());
+
+    // Parameters can be separated with semicolons or commas, and values
+    // are capped, so a bogus report can't overflow.
+    CHECK(capabilities::numeric_params("24;80") == std::vector<int>{24, 80});
+    CHECK(capabilities::numeric_params("65,1,2") == std::vector<int>{65, 1, 2});
+    CHECK(capabilities::numeric_params(";5") == std::vector<int>{0, 5});
+    CHECK(capabilities::numeric_params("12345678901") == std::vector<int>{99999});
+    CHECK(capabilities::numeric_params("").empty());
+    CHECK(capabilities::numeric_params("?64").empty());
+    CHECK(capabilities::numeric_params("24;8x").empty());
+}
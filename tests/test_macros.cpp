@@ -0,0 +1,67 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "check.h"
+
+#include "capabilities.h"
+#include "macros.h"
+#include "options.h"
+#include "os.h"
+#include "peephole.h"
+#include "sequences.h"
+
+#include <sstream>
+#include <string>
+
+void test::macros_suite()
+{
+    // A headless session assumes a terminal that supports macros.
+    const char* args[] = {"vtrex", "--headless", "--replay", "unused"};
+    const auto headless = options{4, args};
+    auto out = std::ostringstream{};
+    const auto connection = os{};
+    const auto caps = capabilities{headless, connection, out};
+    auto macros = macro_manager{caps, headless};
+
+    // The content is hex encoded in a DECDMAC definition, and the macro is
+    // invoked with DECINVM.
+    const auto text = macros.create("ABCDEF");
+    const auto definition = peephole::parse_macro(text.definition());
+    CHECK(definition.has_value());
+    CHECK(definition && definition->content == "ABCDEF");
+    CHECK(text.definition().starts_with("\033P"));
+    CHECK(text.definition().ends_with(";0;1!z414243444546\033\\"));
+    CHECK(definition && text.invocation() == vt::decinvm(definition->id));
+    CHECK(text.content() == "ABCDEF");
+
+    // Bytes above 0x7F encode as two hex digits, like everything else.
+    const auto high = macros.create("ABCDE\xC4\xFF");
+    CHECK(high.definition().ends_with("!z4142434445C4FF\033\\"));
+
+    // Each macro gets the next id.
+    const auto next = peephole::parse_macro(macros.create("GHIJKL").definition());
+    CHECK(definition && next && next->id == definition->id + 2);
+
+    // Anything too short to be worth a macro is just output inline.
+    const auto inline_text = macros.create("ABC");
+    CHECK(inline_text.content() == "ABC");
+    CHECK(inline_text.definition().empty());
+
+    // The content is output until the macro has been uploaded.
+    out.str({});
+    auto uploaded = macros.create("MNOPQR");
+    uploaded.run(out);
+    CHECK(out.str() == "MNOPQR");
+    out.str({});
+    uploaded.upload(out, connection);
+    CHECK(out.str() == uploaded.definition());
+    out.str({});
+    uploaded.run(out);
+    CHECK(out.str() == uploaded.invocation());
+
+    // The checksum sums the bytes as unsigned values, like DECCKSR.
+    CHECK(macro_manager::update_checksum(0, "AB") == static_cast<uint16_t>(-(0x41 + 0x42)));
+    CHECK(macro_manager::update_checksum(0, "\xC4") == 0xFF3C);
+    CHECK(macro_manager::update_checksum(0xFF3C, "\xC4") == 0xFE78);
+}
@@ -0,0 +1,62 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+#include "check.h"
+
+#include "options.h"
+
+#include <initializer_list>
+#include <vector>
+
+namespace {
+
+    options parse(const std::initializer_list<const char*> args)
+    {
+        auto argv = std::vector<const char*>{"vtrex"};
+        argv.insert(argv.end(), args);
+        return options{static_cast<int>(argv.size()), argv.data()};
+    }
+
+}  // namespace
+
+void test::options_suite()
+{
+    const auto defaults = parse({});
+    CHECK(defaults.color && defaults.sound && defaults.blink);
+    CHECK(defaults.fps == 15);
+    CHECK(!defaults.seed && !defaults.scroller && !defaults.budget && !defaults.columns);
+    CHECK(!defaults.exit);
+
+    const auto flags = parse({"--mono", "--mute", "--noblink", "--8bit", "--keep-macros"});
+    CHECK(!flags.color && !flags.sound && !flags.blink);
+    CHECK(flags.eight_bit && flags.keep_macros);
+    CHECK(!flags.exit);
+
+    // Numeric values are clamped to their valid range, and invalid values
+    // are ignored.
+    CHECK(parse({"--speed", "99"}).fps == 30);
+    CHECK(parse({"--speed", "0"}).fps == 1);
+    CHECK(parse({"--speed", "fast"}).fps == 15);
+    CHECK(parse({"--seed", "42"}).seed == 42u);
+    CHECK(!parse({"--seed", "x"}).seed);
+
+    CHECK(parse({"--scroll", "deccra"}).scroller == scroll_strategy::copy_rectangle);
+    CHECK(parse({"--scroll", "sl"}).scroller == scroll_strategy::scroll_left);
+    CHECK(parse({"--scroll", "bogus"}).exit);
+
+    // A budget implies stats, and both require a headless replay.
+    const auto budget = parse({"--headless", "--replay", "x", "--budget", "32"});
+    CHECK(budget.budget == 32.0 && budget.stats && !budget.exit);
+    CHECK(parse({"--stats"}).exit);
+    CHECK(parse({"--headless"}).exit);
+    CHECK(parse({"--sessions", "4"}).exit);
+    CHECK(parse({"--headless", "--replay", "x", "--sessions", "4"}).sessions == 4);
+    CHECK(parse({"--headless", "--replay", "x", "--columns", "132"}).columns == 132);
+    CHECK(parse({"--headless", "--replay", "x", "--columns", "20"}).columns == 60);
+    CHECK(parse({"--columns", "132"}).exit);
+
+    // Unknown options and --help end the program.
+    CHECK(parse({"--bogus"}).exit);
+    CHECK(parse({"--help"}).exit);
+}
@@ -0,0 +1,41 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+// This is the unit test runner. Each suite is registered with CTest as a
+// separate test, so they can be run and reported on individually, but with
+// no arguments every suite is run.
+
+#include "check.h"
+
+#include <array>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+    constexpr auto suites = std::array{
+        std::pair{"buffer", &test::buffer_suite},
+        std::pair{"macros", &test::macros_suite},
+        std::pair{"capabilities", &test::capabilities_suite},
+        std::pair{"options", &test::options_suite},
+    };
+
+}  // namespace
+
+int main(const int argc, const char* argv[])
+{
+    const auto selected = std::string_view{argc > 1 ? argv[1] : ""};
+    auto found = false;
+    for (const auto& [name, suite] : suites) {
+        if (selected.empty() || selected == name) {
+            suite();
+            found = true;
+        }
+    }
+    if (!found) {
+        std::cout << "vtrex-tests: unknown suite '" << selected << "'\n";
+        return 1;
+    }
+    return test::failures;
+}
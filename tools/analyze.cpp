@@ -0,0 +1,367 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+// This is a companion tool for analysing captured VT-Rex output, like a pty
+// capture or a typescript recording. It splits the stream into frames, and
+// reports how the bytes are distributed across the different categories of
+// control sequence, so we can see where the output size could be reduced.
+//
+// The stream is parsed with the same tokenizer that the peephole optimizer
+// uses, and the macro definitions are tracked, so the frame boundaries can
+// still be found when the sequences are hidden inside macro invocations.
+
+#include "peephole.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+using kind = peephole::token::kind;
+
+namespace {
+
+    std::vector<int> parse_params(const std::string_view params)
+    {
+        auto values = std::vector<int>{};
+        auto p = params.data();
+        const auto end = params.data() + params.size();
+        while (p <= end) {
+            auto value = 0;
+            p = std::from_chars(p, end, value).ptr;
+            values.push_back(value);
+            if (p >= end || *p != ';') break;
+            p++;
+        }
+        return values;
+    }
+
+    std::string_view dcs_final(const peephole::token& token)
+    {
+        const auto bytes = std::string_view{token.bytes};
+        const auto introducer = bytes[0] == '\033' ? 2 : 1;
+        const auto params_end = bytes.find_first_not_of("0123456789;", introducer);
+        if (params_end == std::string::npos) return {};
+        const auto final_end = bytes.find_first_not_of(" !\"#$%&'()*+,-./", params_end);
+        if (final_end == std::string::npos) return {};
+        return bytes.substr(params_end, final_end - params_end + 1);
+    }
+
+    std::string category(const peephole::token& token)
+    {
+        switch (token.type) {
+            case kind::text:
+                return "text";
+            case kind::control:
+                return "control";
+            case kind::esc:
+                return "ESC";
+            case kind::osc:
+                return "OSC";
+            case kind::dcs: {
+                const auto final = dcs_final(token);
+                if (final == "!z") return "DECDMAC";
+                if (final == "{") return "DECDLD";
+                return "other DCS";
+            }
+            case kind::csi:
+                break;
+        }
+        static const auto csi_categories = std::map<std::string, std::string>{
+            {"*z", "DECINVM"},
+            {"$v", "DECCRA"},
+            {"'~", "DECDC"},
+            {"H", "CUP"},
+            {"m", "SGR"},
+            {",~", "DECPS"},
+            {" P", "PPA"},
+            {"r", "DECSTBM"},
+        };
+        const auto match = csi_categories.find(token.final);
+        return match != csi_categories.end() ? match->second : "other CSI";
+    }
+
+    std::string printable(const std::string_view bytes)
+    {
+        static constexpr auto c1_names = std::array<const char*, 32>{
+            "PAD", "HOP", "BPH", "NBH", "IND", "NEL", "SSA", "ESA",
+            "HTS", "HTJ", "VTS", "PLD", "PLU", "RI", "SS2", "SS3",
+            "DCS", "PU1", "PU2", "STS", "CCH", "MW", "SPA", "EPA",
+            "SOS", "SGCI", "SCI", "CSI", "ST", "OSC", "PM", "APC"};
+        auto text = std::string{};
+        for (auto i = 0; i < bytes.length(); i++) {
+            const auto ch = static_cast<unsigned char>(bytes[i]);
+            if (ch == 0x1B && i + 1 < bytes.length() && bytes[i + 1] == '[') {
+                text += "CSI ";
+                i++;
+            } else if (ch == 0x1B) {
+                text += "ESC ";
+            } else if (ch >= 0x80 && ch < 0xA0) {
+                text += c1_names[ch - 0x80];
+                text += ' ';
+            } else if (ch < 0x20 || ch == 0x7F) {
+                text += '^';
+                text += static_cast<char>(ch ^ 0x40);
+            } else {
+                text += static_cast<char>(ch);
+            }
+        }
+        return text;
+    }
+
+    class analyzer {
+    public:
+        void parse(const std::string_view data);
+        void report() const;
+
+    private:
+        struct item {
+            size_t bytes;
+            bool offscreen_page;
+            bool visible_page;
+            bool page_copied;
+        };
+
+        struct usage {
+            uint64_t count = 0;
+            uint64_t bytes = 0;
+            uint64_t executed = 0;
+        };
+
+        void _process(const peephole::token& token);
+        void _execute(const peephole::token& token, const int depth);
+        void _end_text_run();
+        void _split_frames();
+
+        std::map<std::string, usage> _categories;
+        std::map<std::string, usage> _sequences;
+        std::map<int, std::string> _macros;
+        std::vector<item> _items;
+        std::vector<uint64_t> _frame_bytes;
+        uint64_t _startup_bytes = 0;
+        uint64_t _total_bytes = 0;
+        size_t _text_run = 0;
+        bool _offscreen_page = false;
+        bool _visible_page = false;
+        bool _page_copied = false;
+        bool _pages_coupled = false;
+    };
+
+    void analyzer::parse(const std::string_view data)
+    {
+        auto tokenizer = peephole::tokenizer{};
+        for (const auto ch : data) {
+            if (tokenizer.parse(ch))
+                _process(tokenizer.current());
+        }
+        _end_text_run();
+        _total_bytes = data.length();
+        _split_frames();
+    }
+
+    void analyzer::_process(const peephole::token& token)
+    {
+        if (token.type == kind::text) {
+            _text_run += token.bytes.length();
+            _categories["text"].executed++;
+            _items.push_back({token.bytes.length(), false, false, false});
+            return;
+        }
+        _end_text_run();
+
+        auto& category_usage = _categories[category(token)];
+        category_usage.count++;
+        category_usage.bytes += token.bytes.length();
+        if (token.type == kind::csi || token.type == kind::esc || token.type == kind::control) {
+            auto& sequence_usage = _sequences[token.bytes];
+            sequence_usage.count++;
+            sequence_usage.bytes += token.bytes.length();
+        }
+
+        _offscreen_page = false;
+        _visible_page = false;
+        _page_copied = false;
+        _execute(token, 0);
+        _items.push_back({token.bytes.length(), _offscreen_page, _visible_page, _page_copied});
+    }
+
+    void analyzer::_execute(const peephole::token& token, const int depth)
+    {
+        _categories[category(token)].executed++;
+
+        if (token.type == kind::dcs) {
+            const auto definition = peephole::parse_macro(token.bytes);
+            if (definition) {
+                if (definition->delete_all) _macros.clear();
+                _macros[definition->id] = definition->content;
+            }
+        } else if (token.type == kind::csi && (token.final == "h" || token.final == "l") && token.params == "?64") {
+            _pages_coupled = token.final == "h";
+        } else if (token.type == kind::csi && token.final == " P") {
+            const auto page = parse_params(token.params)[0];
+            if (page > 1)
+                _offscreen_page = true;
+            else
+                _visible_page = true;
+            // With page flipping, a frame isn't copied to page 1. It's made
+            // visible by moving to its compose page with page coupling on.
+            if (page > 2 && _pages_coupled) _page_copied = true;
+        } else if (token.type == kind::csi && token.final == "$v") {
+            const auto params = parse_params(token.params);
+            if (params.size() >= 8 && params[7] == 1) _page_copied = true;
+        } else if (token.type == kind::csi && token.final == "*z" && depth == 0) {
+            const auto macro = _macros.find(parse_params(token.params)[0]);
+            if (macro != _macros.end()) {
+                auto tokenizer = peephole::tokenizer{};
+                for (const auto ch : macro->second)
+                    if (tokenizer.parse(ch))
+                        _execute(tokenizer.current(), depth + 1);
+            }
+        }
+    }
+
+    void analyzer::_end_text_run()
+    {
+        if (_text_run > 0) {
+            auto& text_usage = _categories["text"];
+            text_usage.count++;
+            text_usage.bytes += _text_run;
+            _text_run = 0;
+        }
+    }
+
+    void analyzer::_split_frames()
+    {
+        // A frame starts with the first selection of an offscreen page, and
+        // ends when it's copied to page 1 (or made visible by page flipping). If we return to page 1 without a
+        // copy (like the capability detection does), it wasn't a frame. The
+        // bytes that follow the copy, like the score, are included in the
+        // frame up until the next one starts.
+        auto frame_starts = std::vector<size_t>{};
+        auto candidate = std::optional<size_t>{};
+        auto returned = false;
+        for (auto i = size_t{0}; i < _items.size(); i++) {
+            const auto& item = _items[i];
+            if (item.page_copied && candidate) {
+                frame_starts.push_back(candidate.value());
+                candidate.reset();
+                returned = false;
+                continue;
+            }
+            // Page 1 is selected immediately before the copy, so we only
+            // give up on a frame when something else comes after that.
+            if (returned)
+                candidate.reset();
+            returned = item.visible_page;
+            if (item.offscreen_page && !candidate)
+                candidate = i;
+        }
+
+        auto next_start = frame_starts.begin();
+        for (auto i = size_t{0}; i < _items.size(); i++) {
+            if (next_start != frame_starts.end() && *next_start == i) {
+                _frame_bytes.push_back(0);
+                next_start++;
+            }
+            if (_frame_bytes.empty())
+                _startup_bytes += _items[i].bytes;
+            else
+                _frame_bytes.back() += _items[i].bytes;
+        }
+    }
+
+    void analyzer::report() const
+    {
+        const auto percent = [&](const auto bytes) {
+            return _total_bytes ? 100.0 * bytes / _total_bytes : 0.0;
+        };
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Total bytes:   " << _total_bytes << "\n";
+        std::cout << "Startup bytes: " << _startup_bytes << "\n";
+        std::cout << "Frames:        " << _frame_bytes.size() << "\n";
+
+        if (!_frame_bytes.empty()) {
+            auto sorted = _frame_bytes;
+            std::sort(sorted.begin(), sorted.end());
+            const auto percentile = [&](const auto p) {
+                return sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)];
+            };
+            auto frame_total = uint64_t{0};
+            for (const auto bytes : sorted) frame_total += bytes;
+            std::cout << "\nBytes per frame\n";
+            std::cout << "  mean   " << double(frame_total) / sorted.size() << "\n";
+            std::cout << "  min    " << sorted.front() << "\n";
+            std::cout << "  median " << percentile(50) << "\n";
+            std::cout << "  90%    " << percentile(90) << "\n";
+            std::cout << "  99%    " << percentile(99) << "\n";
+            std::cout << "  max    " << sorted.back() << "\n";
+        }
+
+        // The executed count includes the sequences run from within macros,
+        // so it shows what the terminal is actually doing, while the bytes
+        // are what was sent over the wire.
+        auto categories = std::vector<std::pair<std::string, usage>>{_categories.begin(), _categories.end()};
+        std::sort(categories.begin(), categories.end(), [](const auto& a, const auto& b) {
+            return a.second.bytes > b.second.bytes;
+        });
+        std::cout << "\nCategory          Sent     Bytes       %  Executed\n";
+        for (const auto& [name, usage] : categories) {
+            std::cout << "  " << std::left << std::setw(12) << name << std::right;
+            std::cout << std::setw(8) << usage.count;
+            std::cout << std::setw(10) << usage.bytes;
+            std::cout << std::setw(8) << percent(usage.bytes);
+            std::cout << std::setw(10) << usage.executed << "\n";
+        }
+
+        auto sequences = std::vector<std::pair<std::string, usage>>{_sequences.begin(), _sequences.end()};
+        std::sort(sequences.begin(), sequences.end(), [](const auto& a, const auto& b) {
+            return a.second.bytes > b.second.bytes;
+        });
+        sequences.resize(std::min<size_t>(sequences.size(), 20));
+        std::cout << "\nMost common sequences   Count     Bytes       %\n";
+        for (const auto& [bytes, usage] : sequences) {
+            std::cout << "  " << std::left << std::setw(20) << printable(bytes) << std::right;
+            std::cout << std::setw(8) << usage.count;
+            std::cout << std::setw(10) << usage.bytes;
+            std::cout << std::setw(8) << percent(usage.bytes) << "\n";
+        }
+    }
+
+}  // namespace
+
+int main(const int argc, const char* argv[])
+{
+    if (argc != 2 || std::string{argv[1]} == "--help") {
+        std::cout << "Usage: vtrex-analyze FILE\n\n";
+        std::cout << "Reports a breakdown of a captured VT-Rex output stream.\n";
+        std::cout << "Use '-' as the FILE to read from stdin.\n";
+        return argc == 2 ? 0 : 1;
+    }
+
+    auto data = std::string{};
+    if (std::string{argv[1]} == "-") {
+        data.assign(std::istreambuf_iterator<char>{std::cin}, {});
+    } else {
+        auto file = std::ifstream{argv[1], std::ios::binary};
+        if (!file) {
+            std::cout << "vtrex-analyze: unable to open '" << argv[1] << "'\n";
+            return 1;
+        }
+        data.assign(std::istreambuf_iterator<char>{file}, {});
+    }
+
+    auto stream_analyzer = analyzer{};
+    stream_analyzer.parse(data);
+    stream_analyzer.report();
+    return 0;
+}
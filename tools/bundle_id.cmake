@@ -0,0 +1,28 @@
+# VT-Rex
+# Copyright (c) 2024 James Holderness
+# Distributed under the MIT License
+
+# This is run as part of the build to produce a header identifying the macro
+# content that the source would generate. It's a hash of everything in the
+# src directory, so any change to the code will invalidate the startup bundles
+# saved by earlier builds. Usage:
+#
+#   cmake -D SOURCE_DIR=DIR -D HEADER=FILE -P bundle_id.cmake
+
+file(GLOB SOURCES "${SOURCE_DIR}/*")
+list(SORT SOURCES)
+set(HASHES "")
+foreach(SOURCE ${SOURCES})
+    file(SHA256 "${SOURCE}" HASH)
+    string(APPEND HASHES "${HASH}")
+endforeach()
+string(SHA256 BUNDLE_ID "${HASHES}")
+string(SUBSTRING "${BUNDLE_ID}" 0 16 BUNDLE_ID)
+
+file(
+    WRITE "${HEADER}"
+    "// Generated by bundle_id.cmake from ${SOURCE_DIR}\n"
+    "// Do not edit this file directly.\n\n"
+    "#pragma once\n\n"
+    "constexpr char bundle_id[] = \"${BUNDLE_ID}\";\n"
+)
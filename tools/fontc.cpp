@@ -0,0 +1,157 @@
+// VT-Rex
+// Copyright (c) 2024 James Holderness
+// Distributed under the MIT License
+
+// This is the font compiler, which is run as part of the build. It reads the
+// glyph bitmaps from a font source file, and produces a header containing the
+// equivalent DECDLD sequence as a constexpr array, so nothing needs to be
+// done with the font at runtime other than sending it.
+//
+// The sixel data is made as short as DECDLD allows: trailing blank sixels
+// are left off each band, trailing blank bands are left off each glyph, and
+// a glyph that's completely blank is reduced to nothing at all.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    using glyph = std::vector<std::string>;
+
+    struct font {
+        char first_char = 0;
+        std::vector<glyph> glyphs;
+    };
+
+    bool parse_font(std::istream& input, font& font, std::string& error)
+    {
+        auto line = std::string{};
+        auto line_number = 0;
+        while (std::getline(input, line)) {
+            line_number++;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line.starts_with("//")) continue;
+            const auto location = "line " + std::to_string(line_number) + ": ";
+            if (line.starts_with("char ") && line.length() == 6) {
+                const auto ch = line[5];
+                if (font.glyphs.empty())
+                    font.first_char = ch;
+                else if (ch != font.first_char + static_cast<int>(font.glyphs.size())) {
+                    error = location + "glyphs must be listed in character order";
+                    return false;
+                }
+                font.glyphs.emplace_back();
+            } else if (line.find_first_not_of("#.") != std::string::npos) {
+                error = location + "unexpected content '" + line + "'";
+                return false;
+            } else if (font.glyphs.empty()) {
+                error = location + "pixel row outside of a glyph";
+                return false;
+            } else {
+                font.glyphs.back().push_back(line);
+            }
+        }
+        if (font.glyphs.empty()) {
+            error = "no glyphs defined";
+            return false;
+        }
+        // Every glyph must have the same dimensions as the first one.
+        const auto& first = font.glyphs.front();
+        for (auto i = 0; i < font.glyphs.size(); i++) {
+            auto& rows = font.glyphs[i];
+            auto valid = rows.size() == first.size() && !rows.empty();
+            for (const auto& row : rows)
+                valid = valid && row.length() == first[0].length();
+            if (!valid) {
+                error = "glyph '" + std::string(1, font.first_char + i) + "' is not the same size as the first";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string encode_glyph(const glyph& rows)
+    {
+        const auto width = rows[0].length();
+        const auto height = rows.size();
+        auto bands = std::vector<std::string>{};
+        for (auto top = size_t{0}; top < height; top += 6) {
+            auto& band = bands.emplace_back();
+            for (auto x = size_t{0}; x < width; x++) {
+                auto sixel = 0;
+                for (auto bit = 0; bit < 6 && top + bit < height; bit++)
+                    if (rows[top + bit][x] == '#')
+                        sixel |= 1 << bit;
+                band += static_cast<char>('?' + sixel);
+            }
+            band.erase(band.find_last_not_of('?') + 1);
+        }
+        while (!bands.empty() && bands.back().empty())
+            bands.pop_back();
+        auto encoded = std::string{};
+        for (auto i = 0; i < bands.size(); i++)
+            encoded += (i > 0 ? "/" : "") + bands[i];
+        return encoded;
+    }
+
+    std::string quote(const std::string& text)
+    {
+        auto quoted = std::string{"\""};
+        for (const auto ch : text) {
+            if (ch == '\\' || ch == '"') quoted += '\\';
+            quoted += ch;
+        }
+        return quoted + "\"";
+    }
+
+}  // namespace
+
+int main(const int argc, const char* argv[])
+{
+    if (argc != 4 || std::string{argv[1]} == "--help") {
+        std::cout << "Usage: vtrex-fontc SOURCE HEADER NAME\n\n";
+        std::cout << "Compiles a soft font SOURCE into a DECDLD sequence, and writes it\n";
+        std::cout << "to HEADER as a constexpr char array with the given NAME.\n";
+        return argc == 2 ? 0 : 1;
+    }
+
+    auto input = std::ifstream{argv[1]};
+    if (!input) {
+        std::cout << "vtrex-fontc: unable to open '" << argv[1] << "'\n";
+        return 1;
+    }
+    auto source = font{};
+    auto error = std::string{};
+    if (!parse_font(input, source, error)) {
+        std::cout << argv[1] << ": " << error << "\n";
+        return 1;
+    }
+
+    // DECDLD: DCS Pfn ; Pcn ; Pe ; Pcmw ; Pw ; Pt ; Pcmh ; Pcss { Dscs D...D ST
+    // We load font 0, starting at the given character, erasing all the other
+    // glyphs, using a full-cell text font, with a 94-character set that is
+    // designated as " @".
+    const auto width = source.glyphs[0][0].length();
+    const auto height = source.glyphs[0].size();
+    const auto start = source.first_char - 0x20;
+    const auto introducer = "\\033P0;" + std::to_string(start) + ";1;" + std::to_string(width) + ";0;2;" + std::to_string(height) + ";0{ @";
+
+    auto output = std::ofstream{argv[2]};
+    output << "// Generated by vtrex-fontc from " << argv[1] << "\n";
+    output << "// Do not edit this file directly.\n\n";
+    output << "#pragma once\n\n";
+    output << "constexpr char " << argv[3] << "[] =\n";
+    output << "    \"" << introducer << "\"\n";
+    for (auto i = 0; i < source.glyphs.size(); i++) {
+        const auto separator = i + 1 < source.glyphs.size() ? ";" : "";
+        output << "    " << quote(encode_glyph(source.glyphs[i]) + separator) << "\n";
+    }
+    output << "    \"\\033\\\\\";\n";
+    if (!output) {
+        std::cout << "vtrex-fontc: unable to write '" << argv[2] << "'\n";
+        return 1;
+    }
+    return 0;
+}